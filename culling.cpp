@@ -0,0 +1,465 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#if CULLING_SIMD_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+Frustum Frustum::fromMatrix(const glm::mat4 &viewProj) {
+  // Gribb and Hartmann, rows of the view projection give the planes
+  glm::vec4 rows[4];
+  for (uint32_t i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i],
+                        viewProj[3][i]);
+  }
+
+  Frustum frustum;
+  frustum.planes[0] = rows[3] + rows[0];
+  frustum.planes[1] = rows[3] - rows[0];
+  frustum.planes[2] = rows[3] + rows[1];
+  frustum.planes[3] = rows[3] - rows[1];
+  frustum.planes[4] = rows[2];
+  frustum.planes[5] = rows[3] - rows[2];
+
+  for (glm::vec4 &plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+
+  return frustum;
+}
+
+void AabbSoA::push(const glm::vec3 &min, const glm::vec3 &max) {
+  minX.push_back(min.x);
+  minY.push_back(min.y);
+  minZ.push_back(min.z);
+  maxX.push_back(max.x);
+  maxY.push_back(max.y);
+  maxZ.push_back(max.z);
+}
+
+void AabbSoA::pushEmpty() {
+  // Whichever corner a plane picks, the distance ends up hugely negative
+  push(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+}
+
+void AabbSoA::clear() {
+  minX.clear();
+  minY.clear();
+  minZ.clear();
+  maxX.clear();
+  maxY.clear();
+  maxZ.clear();
+}
+
+// Components of the corner furthest along each plane normal, a box is outside
+// when that corner is behind the plane
+struct PlaneCorner {
+  const float *x;
+  const float *y;
+  const float *z;
+};
+
+static void planeCorners(const Frustum &frustum, const AabbSoA &boxes,
+                         PlaneCorner corners[6]) {
+  for (uint32_t p = 0; p < 6; ++p) {
+    const glm::vec4 &plane = frustum.planes[p];
+
+    corners[p].x = plane.x > 0 ? boxes.maxX.data() : boxes.minX.data();
+    corners[p].y = plane.y > 0 ? boxes.maxY.data() : boxes.minY.data();
+    corners[p].z = plane.z > 0 ? boxes.maxZ.data() : boxes.minZ.data();
+  }
+}
+
+static inline uint32_t lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+void Culling::cullScalar(const Frustum &frustum, const AabbSoA &boxes,
+                         const uint32_t *ids, size_t begin, size_t end,
+                         std::vector<uint32_t> &visible) {
+  PlaneCorner corners[6];
+  planeCorners(frustum, boxes, corners);
+
+  for (size_t i = begin; i < end; ++i) {
+    bool inside = true;
+
+    for (uint32_t p = 0; p < 6 && inside; ++p) {
+      const glm::vec4 &plane = frustum.planes[p];
+      float distance = plane.x * corners[p].x[i] + plane.y * corners[p].y[i] +
+                       plane.z * corners[p].z[i] + plane.w;
+      inside = distance >= 0.0f;
+    }
+
+    if (inside) {
+      visible.push_back(ids[i]);
+    }
+  }
+}
+
+void Culling::cullSimd(const Frustum &frustum, const AabbSoA &boxes,
+                       const uint32_t *ids, size_t begin, size_t end,
+                       std::vector<uint32_t> &visible) {
+#if CULLING_SIMD_WIDTH == 8
+  PlaneCorner corners[6];
+  planeCorners(frustum, boxes, corners);
+
+  __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+  for (uint32_t p = 0; p < 6; ++p) {
+    planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+    planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+    planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+    planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+  }
+
+  const __m256 zero = _mm256_setzero_ps();
+
+  for (size_t i = begin; i < end; i += 8) {
+    __m256 outside = zero;
+
+    for (uint32_t p = 0; p < 6; ++p) {
+      __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(planeX[p], _mm256_loadu_ps(corners[p].x + i)),
+              _mm256_mul_ps(planeY[p], _mm256_loadu_ps(corners[p].y + i))),
+          _mm256_add_ps(
+              _mm256_mul_ps(planeZ[p], _mm256_loadu_ps(corners[p].z + i)),
+              planeW[p]));
+      outside =
+          _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+    }
+
+    uint32_t mask = ~_mm256_movemask_ps(outside) & 0xFF;
+    while (mask) {
+      visible.push_back(ids[i + lowestBit(mask)]);
+      mask &= mask - 1;
+    }
+  }
+#elif CULLING_SIMD_WIDTH == 4
+  PlaneCorner corners[6];
+  planeCorners(frustum, boxes, corners);
+
+  __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+  for (uint32_t p = 0; p < 6; ++p) {
+    planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+    planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+    planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+    planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+  }
+
+  const __m128 zero = _mm_setzero_ps();
+
+  for (size_t i = begin; i < end; i += 4) {
+    __m128 outside = zero;
+
+    for (uint32_t p = 0; p < 6; ++p) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planeX[p], _mm_loadu_ps(corners[p].x + i)),
+                     _mm_mul_ps(planeY[p], _mm_loadu_ps(corners[p].y + i))),
+          _mm_add_ps(_mm_mul_ps(planeZ[p], _mm_loadu_ps(corners[p].z + i)),
+                     planeW[p]));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+    }
+
+    uint32_t mask = ~_mm_movemask_ps(outside) & 0xF;
+    while (mask) {
+      visible.push_back(ids[i + lowestBit(mask)]);
+      mask &= mask - 1;
+    }
+  }
+#else
+  cullScalar(frustum, boxes, ids, begin, end, visible);
+#endif
+}
+
+void Bvh::build(const std::vector<glm::vec3> &mins,
+                const std::vector<glm::vec3> &maxs) {
+  m_nodes.clear();
+  m_boxes.clear();
+  m_ids.clear();
+
+  if (mins.empty()) {
+    return;
+  }
+
+  std::vector<uint32_t> order(mins.size());
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+
+  m_nodes.reserve(2 * (mins.size() / LEAF_SIZE + 1));
+  buildNode(order, 0, order.size(), mins, maxs);
+}
+
+uint32_t Bvh::buildNode(std::vector<uint32_t> &order, size_t begin, size_t end,
+                        const std::vector<glm::vec3> &mins,
+                        const std::vector<glm::vec3> &maxs) {
+  Node node = {};
+  node.min = glm::vec3(FLT_MAX);
+  node.max = glm::vec3(-FLT_MAX);
+
+  glm::vec3 centroidMin(FLT_MAX);
+  glm::vec3 centroidMax(-FLT_MAX);
+
+  for (size_t i = begin; i < end; ++i) {
+    node.min = glm::min(node.min, mins[order[i]]);
+    node.max = glm::max(node.max, maxs[order[i]]);
+
+    glm::vec3 centroid = (mins[order[i]] + maxs[order[i]]) * 0.5f;
+    centroidMin = glm::min(centroidMin, centroid);
+    centroidMax = glm::max(centroidMax, centroid);
+  }
+
+  uint32_t index = m_nodes.size();
+  m_nodes.push_back(node);
+
+  if (end - begin <= LEAF_SIZE) {
+    m_nodes[index].leaf = true;
+    m_nodes[index].slotBegin = m_ids.size();
+
+    for (size_t i = begin; i < end; ++i) {
+      m_boxes.push(mins[order[i]], maxs[order[i]]);
+      m_ids.push_back(order[i]);
+    }
+
+    // Every leaf starts on a SIMD group
+    while (m_ids.size() % Culling::SLOT_ALIGNMENT != 0) {
+      m_boxes.pushEmpty();
+      m_ids.push_back(UINT32_MAX);
+    }
+
+    m_nodes[index].slotEnd = m_ids.size();
+    return index;
+  }
+
+  // Median split along the axis the centroids spread the most
+  glm::vec3 extent = centroidMax - centroidMin;
+  uint32_t axis = 0;
+  if (extent.y > extent[axis]) {
+    axis = 1;
+  }
+  if (extent.z > extent[axis]) {
+    axis = 2;
+  }
+
+  size_t middle = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + middle,
+                   order.begin() + end, [&](uint32_t a, uint32_t b) {
+                     return mins[a][axis] + maxs[a][axis] <
+                            mins[b][axis] + maxs[b][axis];
+                   });
+
+  uint32_t left = buildNode(order, begin, middle, mins, maxs);
+  uint32_t right = buildNode(order, middle, end, mins, maxs);
+
+  m_nodes[index].left = left;
+  m_nodes[index].right = right;
+  m_nodes[index].slotBegin = m_nodes[left].slotBegin;
+  m_nodes[index].slotEnd = m_nodes[right].slotEnd;
+
+  return index;
+}
+
+void Bvh::cull(const Frustum &frustum, std::vector<uint32_t> &visible) const {
+  if (m_nodes.empty()) {
+    return;
+  }
+
+  uint32_t stack[64];
+  uint32_t stackSize = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0) {
+    const Node &node = m_nodes[stack[--stackSize]];
+
+    bool outside = false;
+    bool inside = true;
+
+    for (uint32_t p = 0; p < 6 && !outside; ++p) {
+      const glm::vec4 &plane = frustum.planes[p];
+      glm::vec3 normal(plane);
+
+      glm::vec3 positive(normal.x > 0 ? node.max.x : node.min.x,
+                         normal.y > 0 ? node.max.y : node.min.y,
+                         normal.z > 0 ? node.max.z : node.min.z);
+      glm::vec3 negative(normal.x > 0 ? node.min.x : node.max.x,
+                         normal.y > 0 ? node.min.y : node.max.y,
+                         normal.z > 0 ? node.min.z : node.max.z);
+
+      outside = glm::dot(normal, positive) + plane.w < 0.0f;
+      inside = inside && glm::dot(normal, negative) + plane.w >= 0.0f;
+    }
+
+    if (outside) {
+      continue;
+    }
+
+    // Everything below is visible, no need to test the boxes
+    if (inside) {
+      for (uint32_t slot = node.slotBegin; slot < node.slotEnd; ++slot) {
+        if (m_ids[slot] != UINT32_MAX) {
+          visible.push_back(m_ids[slot]);
+        }
+      }
+      continue;
+    }
+
+    if (node.leaf) {
+      Culling::cullSimd(frustum, m_boxes, m_ids.data(), node.slotBegin,
+                        node.slotEnd, visible);
+    } else {
+      stack[stackSize++] = node.right;
+      stack[stackSize++] = node.left;
+    }
+  }
+}
+
+bool Culling::benchmark(uint32_t objectCount) {
+  typedef std::chrono::high_resolution_clock Clock;
+
+  const uint32_t FRUSTUM_COUNT = 100;
+  const float SCENE_SIZE = 1000.0f;
+
+  std::mt19937 random(1337);
+  std::uniform_real_distribution<float> position(-SCENE_SIZE, SCENE_SIZE);
+  std::uniform_real_distribution<float> size(0.5f, 10.0f);
+  std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+  std::vector<glm::vec3> mins(objectCount);
+  std::vector<glm::vec3> maxs(objectCount);
+  for (uint32_t i = 0; i < objectCount; ++i) {
+    glm::vec3 center(position(random), position(random), position(random));
+    glm::vec3 extent(size(random), size(random), size(random));
+
+    mins[i] = center - extent;
+    maxs[i] = center + extent;
+  }
+
+  AabbSoA flat;
+  std::vector<uint32_t> flatIds;
+  for (uint32_t i = 0; i < objectCount; ++i) {
+    flat.push(mins[i], maxs[i]);
+    flatIds.push_back(i);
+  }
+  while (flat.size() % SLOT_ALIGNMENT != 0) {
+    flat.pushEmpty();
+    flatIds.push_back(UINT32_MAX);
+  }
+
+  Clock::time_point start = Clock::now();
+  Bvh bvh;
+  bvh.build(mins, maxs);
+  double buildTime =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  // Cameras scattered in the scene looking in random directions
+  std::vector<Frustum> frusta(FRUSTUM_COUNT);
+  for (Frustum &frustum : frusta) {
+    glm::vec3 eye(position(random), position(random), position(random));
+    glm::vec3 forward = glm::normalize(
+        glm::vec3(direction(random), direction(random), direction(random)) +
+        glm::vec3(0.0f, 0.0f, 0.001f));
+    glm::vec3 up =
+        std::abs(forward.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+
+    glm::mat4 view = glm::lookAt(eye, eye + forward, up);
+    glm::mat4 proj =
+        glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+
+    frustum = Frustum::fromMatrix(proj * view);
+  }
+
+  std::vector<uint32_t> visible[3];
+  for (std::vector<uint32_t> &path : visible) {
+    path.reserve(objectCount);
+  }
+
+  double times[3] = {0, 0, 0};
+  size_t counts[3] = {0, 0, 0};
+
+  // First object one path returns and another doesn't
+  bool disagree = false;
+  uint32_t disagreeFrustum = 0;
+  uint32_t disagreePath = 0;
+  uint32_t disagreeObject = 0;
+
+  for (uint32_t f = 0; f < FRUSTUM_COUNT; ++f) {
+    const Frustum &frustum = frusta[f];
+
+    visible[0].clear();
+    start = Clock::now();
+    cullScalar(frustum, flat, flatIds.data(), 0, flat.size(), visible[0]);
+    times[0] +=
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    visible[1].clear();
+    start = Clock::now();
+    cullSimd(frustum, flat, flatIds.data(), 0, flat.size(), visible[1]);
+    times[1] +=
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    visible[2].clear();
+    start = Clock::now();
+    bvh.cull(frustum, visible[2]);
+    times[2] +=
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // The BVH returns objects in node order, compared as sorted sets
+    for (uint32_t i = 0; i < 3; ++i) {
+      counts[i] += visible[i].size();
+      std::sort(visible[i].begin(), visible[i].end());
+    }
+
+    for (uint32_t i = 1; i < 3 && !disagree; ++i) {
+      auto mismatch = std::mismatch(visible[0].begin(), visible[0].end(),
+                                    visible[i].begin(), visible[i].end());
+      if (mismatch.first == visible[0].end() &&
+          mismatch.second == visible[i].end()) {
+        continue;
+      }
+
+      // Whichever set holds the smaller id at the first difference has it
+      // alone
+      disagree = true;
+      disagreeFrustum = f;
+      disagreePath = i;
+      if (mismatch.second == visible[i].end() ||
+          (mismatch.first != visible[0].end() &&
+           *mismatch.first < *mismatch.second)) {
+        disagreeObject = *mismatch.first;
+      } else {
+        disagreeObject = *mismatch.second;
+      }
+    }
+  }
+
+  printf("Culling %u objects, %u frusta, %d wide SIMD\n", objectCount,
+         FRUSTUM_COUNT, CULLING_SIMD_WIDTH);
+  printf("  BVH build:   %8.3f ms ( %zu nodes )\n", buildTime,
+         bvh.nodeCount());
+
+  const char *names[3] = {"Flat scalar", "Flat SIMD", "BVH SIMD"};
+  for (uint32_t i = 0; i < 3; ++i) {
+    printf("  %-12s %8.3f ms per frustum, %zu visible on average\n", names[i],
+           times[i] / FRUSTUM_COUNT, counts[i] / FRUSTUM_COUNT);
+  }
+
+  if (disagree) {
+    printf("ERROR: %s and %s disagree on object %u in frustum %u\n",
+           names[0], names[disagreePath], disagreeObject, disagreeFrustum);
+  }
+
+  return !disagree;
+}
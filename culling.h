@@ -0,0 +1,89 @@
+#ifndef VULKAN_CULLING_H
+#define VULKAN_CULLING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// Boxes tested per instruction, picked from what the compiler targets
+#if defined( __AVX__ )
+#define CULLING_SIMD_WIDTH 8
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+#define CULLING_SIMD_WIDTH 4
+#else
+#define CULLING_SIMD_WIDTH 1
+#endif
+
+struct Frustum {
+  // Normals point inside and are normalized, w is the distance
+  glm::vec4 planes[ 6 ];
+
+  static Frustum fromMatrix( const glm::mat4& viewProj );
+};
+
+// Boxes stored with one array per component so SIMD lanes map to boxes. Slots
+// added with pushEmpty() hold inverted boxes which are always outside.
+struct AabbSoA {
+  std::vector< float > minX;
+  std::vector< float > minY;
+  std::vector< float > minZ;
+  std::vector< float > maxX;
+  std::vector< float > maxY;
+  std::vector< float > maxZ;
+
+  void   push( const glm::vec3& min, const glm::vec3& max );
+  void   pushEmpty();
+  void   clear();
+  size_t size() const { return minX.size(); }
+};
+
+namespace Culling {
+  // Slots are grouped by this many, the SoA is padded to a multiple of it
+  const size_t SLOT_ALIGNMENT = 8;
+
+  // Appends ids[ i ] of every box in [ begin, end ) not outside the frustum,
+  // begin and end are multiples of SLOT_ALIGNMENT
+  void cullScalar( const Frustum& frustum, const AabbSoA& boxes, const uint32_t* ids, size_t begin, size_t end, std::vector< uint32_t >& visible );
+  void cullSimd( const Frustum& frustum, const AabbSoA& boxes, const uint32_t* ids, size_t begin, size_t end, std::vector< uint32_t >& visible );
+
+  // Times the flat scalar, flat SIMD and BVH paths over a random scene, false
+  // when their visible sets disagree
+  bool benchmark( uint32_t objectCount );
+}
+
+// Binary bounding volume hierarchy over object boxes. Leaves own a run of up to
+// LEAF_SIZE slots in one AabbSoA, laid out depth first so every node covers a
+// contiguous slot range.
+class Bvh {
+public:
+  void build( const std::vector< glm::vec3 >& mins, const std::vector< glm::vec3 >& maxs );
+  void cull( const Frustum& frustum, std::vector< uint32_t >& visible ) const;
+
+  size_t nodeCount() const { return m_nodes.size(); }
+
+private:
+  struct Node {
+    glm::vec3 min;
+    glm::vec3 max;
+    uint32_t  left;
+    uint32_t  right;
+    uint32_t  slotBegin;
+    uint32_t  slotEnd;
+    bool      leaf;
+  };
+
+  uint32_t buildNode( std::vector< uint32_t >& order, size_t begin, size_t end, const std::vector< glm::vec3 >& mins, const std::vector< glm::vec3 >& maxs );
+
+  const size_t LEAF_SIZE = 8;
+
+  std::vector< Node >     m_nodes;
+  AabbSoA                 m_boxes;
+  // Object id per slot, padding slots hold UINT32_MAX
+  std::vector< uint32_t > m_ids;
+};
+
+#endif //VULKAN_CULLING_H
@@ -0,0 +1,266 @@
+#include "descriptors.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void DescriptorAllocator::init(VkDevice device,
+                               const std::vector<VkDescriptorPoolSize> &sizes,
+                               uint32_t setsPerPool) {
+  m_device = device;
+  m_sizes = sizes;
+  m_setsPerPool = setsPerPool;
+  m_pools.clear();
+  m_current = 0;
+}
+
+void DescriptorAllocator::destroy() {
+  for (const Pool &pool : m_pools) {
+    vkDestroyDescriptorPool(m_device, pool.pool, nullptr);
+  }
+  m_pools.clear();
+  m_current = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  // Pools are left once their sets are used up, drivers without
+  // VK_KHR_maintenance1 needn't report it. Layouts needing more descriptors
+  // of a type than the sizes give can still run a pool out first.
+  for (;; ++m_current) {
+    bool created = m_current == m_pools.size();
+    if (created) {
+      m_pools.push_back(createPool());
+    }
+
+    Pool &pool = m_pools[m_current];
+    if (pool.used == pool.capacity) {
+      continue;
+    }
+    allocInfo.descriptorPool = pool.pool;
+
+    VkDescriptorSet set;
+    VkResult result = vkAllocateDescriptorSets(m_device, &allocInfo, &set);
+    if (result == VK_SUCCESS) {
+      pool.used++;
+      return set;
+    }
+
+    // A set that doesn't fit an empty pool never will
+    bool full = result == VK_ERROR_OUT_OF_POOL_MEMORY_KHR ||
+                result == VK_ERROR_FRAGMENTED_POOL;
+    if (!full || created) {
+      VK_CHECK(result, "Allocating descriptor set");
+    }
+  }
+}
+
+void DescriptorAllocator::reset() {
+  for (uint32_t i = 0; i < m_pools.size() && i <= m_current; ++i) {
+    VK_CHECK(vkResetDescriptorPool(m_device, m_pools[i].pool, 0),
+             "Resetting descriptor pool");
+    m_pools[i].used = 0;
+  }
+  m_current = 0;
+}
+
+DescriptorAllocator::Pool DescriptorAllocator::createPool() {
+  // Doubles with every pool of the chain
+  uint32_t sets = m_setsPerPool;
+  for (uint32_t i = 0; i < m_pools.size() && sets < MAX_SETS_PER_POOL; ++i) {
+    sets *= 2;
+  }
+  if (sets > MAX_SETS_PER_POOL) {
+    sets = MAX_SETS_PER_POOL;
+  }
+
+  std::vector<VkDescriptorPoolSize> sizes = m_sizes;
+  for (VkDescriptorPoolSize &size : sizes) {
+    size.descriptorCount *= sets;
+  }
+
+  VkDescriptorPoolCreateInfo createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  createInfo.poolSizeCount = sizes.size();
+  createInfo.pPoolSizes = sizes.data();
+  createInfo.maxSets = sets;
+
+  Pool pool = {VK_NULL_HANDLE, sets, 0};
+  VK_CHECK(vkCreateDescriptorPool(m_device, &createInfo, nullptr, &pool.pool),
+           "Creating descriptor pool");
+  return pool;
+}
+
+static bool isImage(VkDescriptorType type) {
+  return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+         type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+         type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+         type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+         type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+// Handles are pointers or 64 bit integers depending on the platform
+template <typename T> static uint64_t handleBits(T handle) {
+  uint64_t bits = 0;
+  memcpy(&bits, &handle, sizeof(handle));
+  return bits;
+}
+
+void DescriptorCache::init(VkDevice device, DescriptorAllocator *allocator,
+                           const DescriptorTemplateFunctions &templates) {
+  m_device = device;
+  m_allocator = allocator;
+  m_templates = templates;
+}
+
+void DescriptorCache::destroy() {
+  for (auto &entry : m_layouts) {
+    if (entry.second.updateTemplate != VK_NULL_HANDLE) {
+      m_templates.destroy(m_device, entry.second.updateTemplate, nullptr);
+    }
+  }
+  m_layouts.clear();
+  m_sets.clear();
+}
+
+void DescriptorCache::addLayout(
+    VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+  Layout &entry = m_layouts[layout];
+  entry.bindings = bindings;
+  entry.updateTemplate = VK_NULL_HANDLE;
+
+  if (m_templates.create == nullptr) {
+    return;
+  }
+
+  // Every binding reads a run of the infos, one DescriptorInfo apart
+  std::vector<VkDescriptorUpdateTemplateEntryKHR> entries;
+  size_t offset = 0;
+  for (const VkDescriptorSetLayoutBinding &binding : bindings) {
+    VkDescriptorUpdateTemplateEntryKHR templateEntry = {};
+    templateEntry.dstBinding = binding.binding;
+    templateEntry.dstArrayElement = 0;
+    templateEntry.descriptorCount = binding.descriptorCount;
+    templateEntry.descriptorType = binding.descriptorType;
+    templateEntry.offset = offset;
+    templateEntry.stride = sizeof(DescriptorInfo);
+    entries.push_back(templateEntry);
+
+    offset += binding.descriptorCount * sizeof(DescriptorInfo);
+  }
+
+  VkDescriptorUpdateTemplateCreateInfoKHR createInfo = {};
+  createInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+  createInfo.descriptorUpdateEntryCount = entries.size();
+  createInfo.pDescriptorUpdateEntries = entries.data();
+  createInfo.templateType =
+      VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+  createInfo.descriptorSetLayout = layout;
+
+  VK_CHECK(m_templates.create(m_device, &createInfo, nullptr,
+                              &entry.updateTemplate),
+           "Creating descriptor update template");
+}
+
+const std::vector<VkDescriptorSetLayoutBinding> &
+DescriptorCache::bindings(VkDescriptorSetLayout layout) const {
+  return this->layout(layout).bindings;
+}
+
+VkDescriptorSet DescriptorCache::get(VkDescriptorSetLayout layout,
+                                     const std::vector<DescriptorInfo> &infos) {
+  const Layout &entry = this->layout(layout);
+
+  std::vector<uint64_t> key;
+  key.reserve(1 + infos.size() * 3);
+  key.push_back(handleBits(layout));
+
+  uint32_t index = 0;
+  for (const VkDescriptorSetLayoutBinding &binding : entry.bindings) {
+    for (uint32_t i = 0; i < binding.descriptorCount; ++i, ++index) {
+      const DescriptorInfo &info = infos[index];
+      if (isImage(binding.descriptorType)) {
+        key.push_back(handleBits(info.image.sampler));
+        key.push_back(handleBits(info.image.imageView));
+        key.push_back(info.image.imageLayout);
+      } else {
+        key.push_back(handleBits(info.buffer.buffer));
+        key.push_back(info.buffer.offset);
+        key.push_back(info.buffer.range);
+      }
+    }
+  }
+
+  auto cached = m_sets.find(key);
+  if (cached != m_sets.end()) {
+    return cached->second;
+  }
+
+  VkDescriptorSet set = m_allocator->allocate(layout);
+  write(set, layout, infos);
+  m_sets.emplace(std::move(key), set);
+  return set;
+}
+
+void DescriptorCache::write(VkDescriptorSet set, VkDescriptorSetLayout layout,
+                            const std::vector<DescriptorInfo> &infos) {
+  const Layout &entry = this->layout(layout);
+
+  if (entry.updateTemplate != VK_NULL_HANDLE) {
+    m_templates.update(m_device, set, entry.updateTemplate, infos.data());
+    return;
+  }
+
+  std::vector<VkWriteDescriptorSet> writes;
+  uint32_t index = 0;
+  for (const VkDescriptorSetLayoutBinding &binding : entry.bindings) {
+    for (uint32_t i = 0; i < binding.descriptorCount; ++i, ++index) {
+      VkWriteDescriptorSet write = {};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = set;
+      write.dstBinding = binding.binding;
+      write.dstArrayElement = i;
+      write.descriptorType = binding.descriptorType;
+      write.descriptorCount = 1;
+      if (isImage(binding.descriptorType)) {
+        write.pImageInfo = &infos[index].image;
+      } else {
+        write.pBufferInfo = &infos[index].buffer;
+      }
+      writes.push_back(write);
+    }
+  }
+
+  vkUpdateDescriptorSets(m_device, writes.size(), writes.data(), 0, nullptr);
+}
+
+void DescriptorCache::clear() {
+  m_allocator->reset();
+  m_sets.clear();
+}
+
+const DescriptorCache::Layout &
+DescriptorCache::layout(VkDescriptorSetLayout layout) const {
+  auto entry = m_layouts.find(layout);
+  if (entry == m_layouts.end()) {
+    printf("ERROR: Descriptor set layout was not added to the cache\n");
+    exit(EXIT_FAILURE);
+  }
+  return entry->second;
+}
+
+size_t DescriptorCache::KeyHash::operator()(
+    const std::vector<uint64_t> &key) const {
+  // FNV-1a over the words
+  uint64_t hash = 14695981039346656037ull;
+  for (uint64_t word : key) {
+    hash = (hash ^ word) * 1099511628211ull;
+  }
+  return hash;
+}
@@ -0,0 +1,105 @@
+#ifndef VULKAN_DESCRIPTORS_H
+#define VULKAN_DESCRIPTORS_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include "utils.h"
+
+// One descriptor as update templates read it, which member is used follows the
+// binding's type. Texel buffer views aren't supported.
+union DescriptorInfo {
+  VkDescriptorImageInfo  image;
+  VkDescriptorBufferInfo buffer;
+};
+
+// Chains pools of growing size, a new one is created once the last is
+// exhausted. reset() hands every set back with one call per pool, the pools
+// are kept for the next round.
+class DescriptorAllocator {
+public:
+  // Sizes are the descriptors of each type one set needs, a pool holds
+  // setsPerPool sets and every new one twice as many up to MAX_SETS_PER_POOL
+  void init( VkDevice device, const std::vector< VkDescriptorPoolSize >& sizes, uint32_t setsPerPool );
+  void destroy();
+
+  VkDescriptorSet allocate( VkDescriptorSetLayout layout );
+  // Nothing allocated since the last reset may still be in use on the GPU
+  void reset();
+
+  uint32_t poolCount() const { return m_pools.size(); }
+
+private:
+  static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+  struct Pool {
+    VkDescriptorPool pool;
+    uint32_t         capacity;
+    uint32_t         used;
+  };
+
+  Pool createPool();
+
+  VkDevice                            m_device = VK_NULL_HANDLE;
+  std::vector< VkDescriptorPoolSize > m_sizes;
+  uint32_t                            m_setsPerPool = 0;
+  std::vector< Pool >                 m_pools;
+  // Pools before it are full until the next reset
+  uint32_t                            m_current = 0;
+};
+
+// Descriptor update templates of the KHR extension, all null without it
+struct DescriptorTemplateFunctions {
+  PFN_vkCreateDescriptorUpdateTemplateKHR  create  = nullptr;
+  PFN_vkDestroyDescriptorUpdateTemplateKHR destroy = nullptr;
+  PFN_vkUpdateDescriptorSetWithTemplateKHR update  = nullptr;
+};
+
+// Sets whose descriptors never change, anyone asking for the same descriptors
+// in the same layout gets the same set. Sets are written with one update
+// template per layout, or vkUpdateDescriptorSets without the extension.
+class DescriptorCache {
+public:
+  // The allocator is the cache's own, clear() resets it
+  void init( VkDevice device, DescriptorAllocator* allocator, const DescriptorTemplateFunctions& templates );
+  void destroy();
+
+  // Layouts are added once with the bindings they were created from, sorted
+  // by binding as Shaders::setBindings returns them
+  void addLayout( VkDescriptorSetLayout layout, const std::vector< VkDescriptorSetLayoutBinding >& bindings );
+  const std::vector< VkDescriptorSetLayoutBinding >& bindings( VkDescriptorSetLayout layout ) const;
+
+  // Infos hold one entry per descriptor of every binding, in binding order
+  VkDescriptorSet get( VkDescriptorSetLayout layout, const std::vector< DescriptorInfo >& infos );
+  // Writes a set allocated elsewhere, a per frame one for example
+  void write( VkDescriptorSet set, VkDescriptorSetLayout layout, const std::vector< DescriptorInfo >& infos );
+
+  // Drops every set once the resources they point at are destroyed, the GPU
+  // must be done with all of them
+  void clear();
+
+private:
+  struct Layout {
+    std::vector< VkDescriptorSetLayoutBinding > bindings;
+    VkDescriptorUpdateTemplateKHR               updateTemplate;
+  };
+
+  struct KeyHash {
+    size_t operator()( const std::vector< uint64_t >& key ) const;
+  };
+
+  const Layout& layout( VkDescriptorSetLayout layout ) const;
+
+  VkDevice                    m_device    = VK_NULL_HANDLE;
+  DescriptorAllocator*        m_allocator = nullptr;
+  DescriptorTemplateFunctions m_templates;
+
+  std::unordered_map< VkDescriptorSetLayout, Layout > m_layouts;
+  // Keyed by the layout then the handles, offsets and ranges of the infos
+  std::unordered_map< std::vector< uint64_t >, VkDescriptorSet, KeyHash > m_sets;
+};
+
+#endif //VULKAN_DESCRIPTORS_H
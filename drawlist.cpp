@@ -0,0 +1,56 @@
+#include "drawlist.h"
+
+#include <cstring>
+
+uint64_t DrawList::makeKey(uint32_t pipeline, uint32_t descriptorSet,
+                           uint32_t mesh, float depth) {
+  // Non negative floats order like their bits, the top ones are kept
+  uint32_t depthBits;
+  depth = depth > 0.0f ? depth : 0.0f;
+  memcpy(&depthBits, &depth, sizeof(depthBits));
+
+  uint64_t key = pipeline & ((1u << PIPELINE_BITS) - 1);
+  key = key << DESCRIPTOR_SET_BITS |
+        (descriptorSet & ((1u << DESCRIPTOR_SET_BITS) - 1));
+  key = key << MESH_BITS | (mesh & ((1u << MESH_BITS) - 1));
+  key = key << DEPTH_BITS | depthBits >> (32 - DEPTH_BITS);
+
+  return key;
+}
+
+void DrawList::sort() {
+  const uint32_t PASSES = sizeof(uint64_t);
+
+  // All histograms in one read of the keys
+  uint32_t counts[PASSES][256] = {};
+  for (const DrawItem &item : m_items) {
+    for (uint32_t pass = 0; pass < PASSES; ++pass) {
+      counts[pass][(item.key >> (pass * 8)) & 0xFF]++;
+    }
+  }
+
+  m_scratch.resize(m_items.size());
+
+  for (uint32_t pass = 0; pass < PASSES; ++pass) {
+    uint32_t shift = pass * 8;
+
+    // Every key has the same byte here, the order can't change
+    if (m_items.empty() ||
+        counts[pass][(m_items[0].key >> shift) & 0xFF] == m_items.size()) {
+      continue;
+    }
+
+    uint32_t offsets[256];
+    uint32_t offset = 0;
+    for (uint32_t bucket = 0; bucket < 256; ++bucket) {
+      offsets[bucket] = offset;
+      offset += counts[pass][bucket];
+    }
+
+    for (const DrawItem &item : m_items) {
+      m_scratch[offsets[(item.key >> shift) & 0xFF]++] = item;
+    }
+
+    m_items.swap(m_scratch);
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef VULKAN_DRAWLIST_H
+#define VULKAN_DRAWLIST_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// State changes of the last recorded frame, draws that kept the state of the
+// previous one don't count
+struct BindCounts {
+  uint32_t pipelines;
+  uint32_t descriptorSets;
+  uint32_t vertexBuffers;
+  uint32_t draws;
+};
+
+// What the command buffer being recorded has bound
+struct BoundState {
+  VkPipeline pipeline      = VK_NULL_HANDLE;
+  uint32_t   descriptorSet = UINT32_MAX;
+  VkBuffer   vertexBuffer  = VK_NULL_HANDLE;
+};
+
+struct DrawItem {
+  uint64_t key;
+  // Index of the draw in the renderer's own table
+  uint32_t draw;
+};
+
+// Draws keyed by the state they need, most expensive change in the highest
+// bits, and sorted so draws sharing a state are recorded next to each other.
+// Key from the top: pipeline, descriptor set, mesh, then depth front to back.
+class DrawList {
+public:
+  static const uint32_t PIPELINE_BITS       = 8;
+  static const uint32_t DESCRIPTOR_SET_BITS = 12;
+  static const uint32_t MESH_BITS           = 20;
+  static const uint32_t DEPTH_BITS          = 24;
+
+  // Depth is any non negative value growing with the distance to the camera
+  static uint64_t makeKey( uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth );
+
+  static uint32_t pipeline( uint64_t key )      { return key >> ( DESCRIPTOR_SET_BITS + MESH_BITS + DEPTH_BITS ); }
+  static uint32_t descriptorSet( uint64_t key ) { return ( key >> ( MESH_BITS + DEPTH_BITS ) ) & ( ( 1u << DESCRIPTOR_SET_BITS ) - 1 ); }
+  static uint32_t mesh( uint64_t key )          { return ( key >> DEPTH_BITS ) & ( ( 1u << MESH_BITS ) - 1 ); }
+
+  void clear() { m_items.clear(); }
+  void add( uint64_t key, uint32_t draw ) { m_items.push_back( { key, draw } ); }
+
+  // Least significant byte first radix sort, bytes every key shares are skipped
+  void sort();
+
+  const std::vector< DrawItem >& items() const { return m_items; }
+
+private:
+  std::vector< DrawItem > m_items;
+  std::vector< DrawItem > m_scratch;
+};
+
+#endif //VULKAN_DRAWLIST_H
@@ -0,0 +1,67 @@
+#include "geometry.h"
+
+#include <algorithm>
+
+void RangeAllocator::init(uint32_t size) {
+  m_free.clear();
+  m_free.push_back({0, size});
+  m_size = size;
+  m_used = 0;
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  for (auto range = m_free.begin(); range != m_free.end(); ++range) {
+    if (range->size < size) {
+      continue;
+    }
+
+    uint32_t offset = range->offset;
+    range->offset += size;
+    range->size -= size;
+    if (range->size == 0) {
+      m_free.erase(range);
+    }
+
+    m_used += size;
+    return offset;
+  }
+
+  return INVALID;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  auto next = std::lower_bound(m_free.begin(), m_free.end(), offset,
+                               [](const Range &range, uint32_t offset) {
+                                 return range.offset < offset;
+                               });
+  m_used -= size;
+
+  // Joins the free range before it, then possibly the one after both
+  if (next != m_free.begin()) {
+    auto previous = next - 1;
+    if (previous->offset + previous->size == offset) {
+      previous->size += size;
+      if (next != m_free.end() && offset + size == next->offset) {
+        previous->size += next->size;
+        m_free.erase(next);
+      }
+      return;
+    }
+  }
+
+  if (next != m_free.end() && offset + size == next->offset) {
+    next->offset = offset;
+    next->size += size;
+    return;
+  }
+
+  m_free.insert(next, {offset, size});
+}
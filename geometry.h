@@ -0,0 +1,33 @@
+#ifndef VULKAN_GEOMETRY_H
+#define VULKAN_GEOMETRY_H
+
+#include <cstdint>
+#include <vector>
+
+// Hands out ranges of a pool of fixed size, in elements of the pool. First fit
+// from a free list sorted by offset, freed ranges merge with their neighbours.
+class RangeAllocator {
+public:
+  static const uint32_t INVALID = UINT32_MAX;
+
+  void init( uint32_t size );
+
+  // Offset of the range, INVALID when no free range is large enough
+  uint32_t allocate( uint32_t size );
+  void free( uint32_t offset, uint32_t size );
+
+  uint32_t size() const { return m_size; }
+  uint32_t used() const { return m_used; }
+
+private:
+  struct Range {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  std::vector< Range > m_free;
+  uint32_t             m_size = 0;
+  uint32_t             m_used = 0;
+};
+
+#endif //VULKAN_GEOMETRY_H
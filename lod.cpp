@@ -0,0 +1,393 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// Sum of squared distances to planes, weighted by the area of their triangles.
+// The symmetric 4x4 matrix is stored as its upper triangle.
+struct Quadric {
+  double a00, a01, a02, a03;
+  double a11, a12, a13;
+  double a22, a23;
+  double a33;
+  double weight;
+};
+
+struct Collapse {
+  double   cost;
+  uint32_t from;
+  uint32_t to;
+};
+
+static Quadric planeQuadric(const glm::vec3 &a, const glm::vec3 &b,
+                            const glm::vec3 &c) {
+  Quadric quadric = {};
+
+  glm::vec3 normal = glm::cross(b - a, c - a);
+  float length = glm::length(normal);
+  if (length <= 0.0f) {
+    return quadric;
+  }
+
+  double x = normal.x / length;
+  double y = normal.y / length;
+  double z = normal.z / length;
+  double d = -(x * a.x + y * a.y + z * a.z);
+  double w = length * 0.5;
+
+  quadric.a00 = w * x * x;
+  quadric.a01 = w * x * y;
+  quadric.a02 = w * x * z;
+  quadric.a03 = w * x * d;
+  quadric.a11 = w * y * y;
+  quadric.a12 = w * y * z;
+  quadric.a13 = w * y * d;
+  quadric.a22 = w * z * z;
+  quadric.a23 = w * z * d;
+  quadric.a33 = w * d * d;
+  quadric.weight = w;
+
+  return quadric;
+}
+
+static void addQuadric(Quadric &quadric, const Quadric &other) {
+  quadric.a00 += other.a00;
+  quadric.a01 += other.a01;
+  quadric.a02 += other.a02;
+  quadric.a03 += other.a03;
+  quadric.a11 += other.a11;
+  quadric.a12 += other.a12;
+  quadric.a13 += other.a13;
+  quadric.a22 += other.a22;
+  quadric.a23 += other.a23;
+  quadric.a33 += other.a33;
+  quadric.weight += other.weight;
+}
+
+// Squared distance to the planes, averaged over their area
+static double quadricError(const Quadric &a, const Quadric &b,
+                           const glm::vec3 &point) {
+  Quadric q = a;
+  addQuadric(q, b);
+
+  if (q.weight <= 0.0) {
+    return 0.0;
+  }
+
+  double x = point.x;
+  double y = point.y;
+  double z = point.z;
+
+  double error = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z +
+                 2.0 * q.a03 * x + q.a11 * y * y + 2.0 * q.a12 * y * z +
+                 2.0 * q.a13 * y + q.a22 * z * z + 2.0 * q.a23 * z + q.a33;
+
+  return std::max(error, 0.0) / q.weight;
+}
+
+static glm::vec3 faceNormal(const glm::vec3 &a, const glm::vec3 &b,
+                            const glm::vec3 &c) {
+  return glm::cross(b - a, c - a);
+}
+
+std::vector<uint32_t> Lod::simplify(const std::vector<Vertex> &vertices,
+                                    const std::vector<uint32_t> &indices,
+                                    size_t targetIndexCount, float &error,
+                                    bool inside) {
+  error = 0.0f;
+
+  std::vector<uint32_t> positionIds;
+  uint32_t positionCount = Meshlets::weldPositions(vertices, positionIds);
+
+  // Split vertices can't move without tearing the seam apart
+  std::vector<uint32_t> copies(positionCount, 0);
+  for (uint32_t id : positionIds) {
+    copies[id]++;
+  }
+
+  std::vector<bool> locked(vertices.size(), false);
+  for (uint32_t i = 0; i < vertices.size(); ++i) {
+    locked[i] = copies[positionIds[i]] > 1;
+  }
+
+  // Edges not shared by exactly two triangles are on a border
+  std::unordered_map<uint64_t, uint32_t> edges;
+  edges.reserve(indices.size());
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      uint64_t a = positionIds[indices[i + corner]];
+      uint64_t b = positionIds[indices[i + (corner + 1) % 3]];
+      edges[std::min(a, b) << 32 | std::max(a, b)]++;
+    }
+  }
+
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      uint32_t a = indices[i + corner];
+      uint32_t b = indices[i + (corner + 1) % 3];
+      uint64_t keyA = positionIds[a];
+      uint64_t keyB = positionIds[b];
+
+      if (edges[std::min(keyA, keyB) << 32 | std::max(keyA, keyB)] != 2) {
+        locked[a] = true;
+        locked[b] = true;
+      }
+    }
+  }
+
+  // Sign of the volume, the face normals point outward when positive
+  double volume = 0.0;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    const glm::vec3 &a = vertices[indices[i + 0]].pos;
+    const glm::vec3 &b = vertices[indices[i + 1]].pos;
+    const glm::vec3 &c = vertices[indices[i + 2]].pos;
+    volume += glm::dot(a, glm::cross(b, c));
+  }
+  float outward = volume < 0.0 ? -1.0f : 1.0f;
+
+  std::vector<Quadric> quadrics(positionCount, Quadric{});
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    Quadric plane = planeQuadric(vertices[indices[i + 0]].pos,
+                                 vertices[indices[i + 1]].pos,
+                                 vertices[indices[i + 2]].pos);
+
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      addQuadric(quadrics[positionIds[indices[i + corner]]], plane);
+    }
+  }
+
+  std::vector<uint32_t> result = indices;
+  std::vector<uint32_t> remap(vertices.size());
+  std::vector<bool> touched(vertices.size());
+  std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1);
+  std::vector<uint32_t> adjacency;
+  std::vector<Collapse> collapses;
+  double maximumCost = 0.0;
+
+  // Every pass collapses edges whose neighbourhoods don't overlap, cheapest
+  // first, so each collapse is checked against geometry that can't change
+  while (result.size() > targetIndexCount) {
+    std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+    for (uint32_t index : result) {
+      adjacencyOffsets[index + 1]++;
+    }
+    for (size_t i = 1; i < adjacencyOffsets.size(); ++i) {
+      adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+    }
+
+    adjacency.resize(result.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(),
+                               adjacencyOffsets.end() - 1);
+    for (uint32_t i = 0; i < result.size(); ++i) {
+      adjacency[fill[result[i]]++] = i / 3;
+    }
+
+    // Both directions of an inner edge show up, one per triangle
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (uint32_t corner = 0; corner < 3; ++corner) {
+        uint32_t from = result[i + corner];
+        uint32_t to = result[i + (corner + 1) % 3];
+
+        if (locked[from]) {
+          continue;
+        }
+
+        double cost =
+            quadricError(quadrics[positionIds[from]], quadrics[positionIds[to]],
+                         vertices[to].pos);
+        collapses.push_back({cost, from, to});
+      }
+    }
+
+    if (collapses.empty()) {
+      break;
+    }
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &a, const Collapse &b) {
+                return a.cost < b.cost;
+              });
+
+    for (uint32_t i = 0; i < remap.size(); ++i) {
+      remap[i] = i;
+    }
+    std::fill(touched.begin(), touched.end(), false);
+
+    size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+    size_t removed = 0;
+
+    for (const Collapse &collapse : collapses) {
+      if (removed >= trianglesToRemove) {
+        break;
+      }
+
+      if (touched[collapse.from] || touched[collapse.to]) {
+        continue;
+      }
+
+      uint32_t target = positionIds[collapse.to];
+      glm::vec3 destination = vertices[collapse.to].pos;
+      glm::vec3 offset = destination - vertices[collapse.from].pos;
+
+      // Triangles sharing the edge vanish, the others must not flip over or
+      // turn steeply, which would flip them over a few passes
+      bool flips = false;
+      size_t collapsed = 0;
+      for (uint32_t a = adjacencyOffsets[collapse.from];
+           a < adjacencyOffsets[collapse.from + 1]; ++a) {
+        const uint32_t *triangle = &result[adjacency[a] * 3];
+
+        glm::vec3 corners[3];
+        glm::vec3 moved[3];
+        bool shared = false;
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+          corners[corner] = vertices[triangle[corner]].pos;
+          moved[corner] = triangle[corner] == collapse.from ? destination
+                                                            : corners[corner];
+          shared = shared || positionIds[triangle[corner]] == target;
+        }
+
+        if (shared) {
+          collapsed++;
+          continue;
+        }
+
+        glm::vec3 before = faceNormal(corners[0], corners[1], corners[2]);
+        glm::vec3 after = faceNormal(moved[0], moved[1], moved[2]);
+        if (glm::dot(before, after) <=
+            0.25f * glm::length(before) * glm::length(after)) {
+          flips = true;
+          break;
+        }
+
+        // In front of one of the planes, the moved fan would bulge out of it
+        if (inside && glm::dot(before, offset) * outward > 0.0f) {
+          flips = true;
+          break;
+        }
+      }
+
+      if (flips || collapsed == 0) {
+        continue;
+      }
+
+      remap[collapse.from] = collapse.to;
+      addQuadric(quadrics[target], quadrics[positionIds[collapse.from]]);
+      maximumCost = std::max(maximumCost, collapse.cost);
+      removed += collapsed;
+
+      for (uint32_t a = adjacencyOffsets[collapse.from];
+           a < adjacencyOffsets[collapse.from + 1]; ++a) {
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+          touched[result[adjacency[a] * 3 + corner]] = true;
+        }
+      }
+    }
+
+    if (removed == 0) {
+      break;
+    }
+
+    // Drop the triangles which lost a corner
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = remap[result[i + 0]];
+      uint32_t b = remap[result[i + 1]];
+      uint32_t c = remap[result[i + 2]];
+
+      if (positionIds[a] == positionIds[b] ||
+          positionIds[b] == positionIds[c] ||
+          positionIds[c] == positionIds[a]) {
+        continue;
+      }
+
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  error = (float)std::sqrt(maximumCost);
+  return result;
+}
+
+void Lod::build(const std::vector<Vertex> &vertices,
+                std::vector<uint32_t> &indices, std::vector<Meshlet> &meshlets,
+                std::vector<MeshLod> &lods) {
+  meshlets.clear();
+  lods.clear();
+
+  std::vector<uint32_t> levelIndices = std::move(indices);
+  std::vector<uint32_t> combined;
+  float error = 0.0f;
+
+  for (uint32_t level = 0; level < MAX_LEVELS; ++level) {
+    if (level > 0) {
+      float levelError = 0.0f;
+      std::vector<uint32_t> simplified =
+          simplify(vertices, levelIndices, levelIndices.size() / 6 * 3,
+                   levelError);
+
+      // Not worth a level when the mesh is mostly seams and borders
+      if (simplified.empty() ||
+          simplified.size() > levelIndices.size() * 3 / 4) {
+        break;
+      }
+
+      // Each level is simplified from the previous one, errors add up
+      error += levelError;
+      levelIndices = std::move(simplified);
+    }
+
+    std::vector<Meshlet> levelMeshlets;
+    Meshlets::build(vertices, levelIndices, levelMeshlets);
+
+    lods.push_back({(uint32_t)meshlets.size(), (uint32_t)levelMeshlets.size(),
+                    (uint32_t)combined.size(), (uint32_t)levelIndices.size(),
+                    error});
+
+    for (Meshlet &meshlet : levelMeshlets) {
+      meshlet.firstIndex += combined.size();
+      meshlets.push_back(meshlet);
+    }
+    combined.insert(combined.end(), levelIndices.begin(), levelIndices.end());
+  }
+
+  indices = std::move(combined);
+}
+
+std::vector<uint32_t> Lod::occluder(const std::vector<Vertex> &vertices,
+                                    const std::vector<uint32_t> &indices,
+                                    const std::vector<MeshLod> &lods) {
+  if (lods.empty()) {
+    return {};
+  }
+
+  std::vector<uint32_t> full(indices.begin() + lods[0].firstIndex,
+                             indices.begin() + lods[0].firstIndex +
+                                 lods[0].indexCount);
+
+  float error = 0.0f;
+  return simplify(vertices, full, full.size() / 24 * 3, error, true);
+}
+
+uint32_t Lod::select(const std::vector<MeshLod> &lods, float scale,
+                     float distance, float pixelsPerUnit, float threshold) {
+  // Inside the bounds, the surface can be arbitrarily close
+  if (distance <= 0.0f) {
+    return 0;
+  }
+
+  uint32_t level = 0;
+  for (uint32_t i = 1; i < lods.size(); ++i) {
+    if (lods[i].error * scale * pixelsPerUnit / distance > threshold) {
+      break;
+    }
+    level = i;
+  }
+
+  return level;
+}
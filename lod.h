@@ -0,0 +1,44 @@
+#ifndef VULKAN_LOD_H
+#define VULKAN_LOD_H
+
+#include <cstdint>
+#include <vector>
+
+#include "vertices.h"
+#include "meshlets.h"
+
+// One level of a mesh's LOD chain, every level indexes the same vertices
+struct MeshLod {
+  uint32_t firstMeshlet;
+  uint32_t meshletCount;
+  // The level's meshlets cover this index range
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // Distance the level strays from the full mesh, in model space
+  float    error;
+};
+
+namespace Lod {
+  const uint32_t MAX_LEVELS = 4;
+
+  // Builds the chain, every level has about half the triangles of the previous
+  // one. The levels' indices are stored one after the other and each level is
+  // split into its own meshlets.
+  void build( const std::vector< Vertex >& vertices, std::vector< uint32_t >& indices, std::vector< Meshlet >& meshlets, std::vector< MeshLod >& lods );
+
+  // Quadric error edge collapse. Vertices only move onto a neighbour so the
+  // vertex buffer is kept, borders and UV seams never move. Inside only allows
+  // collapses moving no surface outward, the result then stays within the
+  // mesh and may stop short of the target.
+  std::vector< uint32_t > simplify( const std::vector< Vertex >& vertices, const std::vector< uint32_t >& indices, size_t targetIndexCount, float& error, bool inside = false );
+
+  // Level 0 simplified to about an eighth of its triangles while staying
+  // inside it, whatever it hides the full mesh hides too
+  std::vector< uint32_t > occluder( const std::vector< Vertex >& vertices, const std::vector< uint32_t >& indices, const std::vector< MeshLod >& lods );
+
+  // Coarsest level whose error stays under threshold pixels, pixelsPerUnit is
+  // the height in pixels of one unit seen from a distance of one
+  uint32_t select( const std::vector< MeshLod >& lods, float scale, float distance, float pixelsPerUnit, float threshold );
+}
+
+#endif //VULKAN_LOD_H
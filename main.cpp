@@ -1,6 +1,16 @@
 #include "vulkan.h"
 
-int main() {
+int main( int argc, char** argv ) {
+  if( argc > 1 && strcmp( argv[ 1 ], "--bench-culling" ) == 0 ) {
+    bool agree = Culling::benchmark( argc > 2 ? atoi( argv[ 2 ] ) : 100000 );
+    return agree ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if( argc > 1 && strcmp( argv[ 1 ], "--bench-occlusion" ) == 0 ) {
+    bool conservative = SoftwareOcclusion::benchmark( argc > 2 ? atoi( argv[ 2 ] ) : 100000 );
+    return conservative ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   printf( "Starting app...\n");
 
   Vulkan app;
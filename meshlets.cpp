@@ -0,0 +1,247 @@
+#include "meshlets.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Exact positions, vertices split on UV seams weld back together
+struct PositionKey {
+  float x, y, z;
+
+  bool operator==(const PositionKey &other) const {
+    return x == other.x && y == other.y && z == other.z;
+  }
+};
+
+struct PositionHash {
+  size_t operator()(const PositionKey &key) const {
+    uint32_t bits[3];
+    memcpy(bits, &key, sizeof(bits));
+    return ((size_t)bits[0] * 73856093) ^ ((size_t)bits[1] * 19349663) ^
+           ((size_t)bits[2] * 83492791);
+  }
+};
+
+static void computeBounds(const std::vector<Vertex> &vertices,
+                          const uint32_t *indices, Meshlet &meshlet) {
+  glm::vec3 minimum(FLT_MAX);
+  glm::vec3 maximum(-FLT_MAX);
+  for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+    minimum = glm::min(minimum, glm::vec3(vertices[indices[i]].pos));
+    maximum = glm::max(maximum, glm::vec3(vertices[indices[i]].pos));
+  }
+
+  glm::vec3 center = (minimum + maximum) * 0.5f;
+  float radius = 0.0f;
+  for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+    glm::vec3 position = vertices[indices[i]].pos;
+    radius = std::max(radius, glm::length(position - center));
+  }
+
+  meshlet.sphere = glm::vec4(center, radius);
+
+  // Average of the face normals, the cutoff comes from the widest one
+  std::vector<glm::vec3> normals;
+  glm::vec3 axis(0.0f);
+  for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+    glm::vec3 a = vertices[indices[i + 0]].pos;
+    glm::vec3 b = vertices[indices[i + 1]].pos;
+    glm::vec3 c = vertices[indices[i + 2]].pos;
+
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float area = glm::length(normal);
+    if (area <= 0.0f) {
+      continue;
+    }
+
+    normals.push_back(normal / area);
+    axis += normals.back();
+  }
+
+  meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  if (normals.empty() || glm::length(axis) <= 0.0f) {
+    return;
+  }
+
+  axis = glm::normalize(axis);
+
+  float minimumDot = 1.0f;
+  for (const glm::vec3 &normal : normals) {
+    minimumDot = std::min(minimumDot, glm::dot(normal, axis));
+  }
+
+  // Wider than a half sphere, some triangle always faces the camera
+  float cutoff =
+      minimumDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+  meshlet.cone = glm::vec4(axis, cutoff);
+}
+
+uint32_t Meshlets::weldPositions(const std::vector<Vertex> &vertices,
+                                 std::vector<uint32_t> &positionIds) {
+  positionIds.resize(vertices.size());
+
+  std::unordered_map<PositionKey, uint32_t, PositionHash> welded;
+  welded.reserve(vertices.size());
+  for (uint32_t i = 0; i < vertices.size(); ++i) {
+    PositionKey key = {vertices[i].pos.x, vertices[i].pos.y,
+                       vertices[i].pos.z};
+    positionIds[i] = welded.emplace(key, welded.size()).first->second;
+  }
+
+  return welded.size();
+}
+
+void Meshlets::build(const std::vector<Vertex> &vertices,
+                     std::vector<uint32_t> &indices,
+                     std::vector<Meshlet> &meshlets) {
+  meshlets.clear();
+
+  uint32_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Adjacency is built on welded positions so meshlets grow across seams
+  std::vector<uint32_t> positionIds;
+  uint32_t positionCount = weldPositions(vertices, positionIds);
+
+  // Triangles around each welded position, stored as offsets into one array
+  std::vector<uint32_t> adjacencyOffsets(positionCount + 1, 0);
+  for (uint32_t index : indices) {
+    adjacencyOffsets[positionIds[index] + 1]++;
+  }
+  for (size_t i = 1; i < adjacencyOffsets.size(); ++i) {
+    adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+  }
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> fill(adjacencyOffsets.begin(),
+                             adjacencyOffsets.end() - 1);
+  for (uint32_t i = 0; i < indices.size(); ++i) {
+    adjacency[fill[positionIds[indices[i]]]++] = i / 3;
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  // Meshlet each vertex or candidate triangle was last added to
+  std::vector<uint32_t> vertexTags(vertices.size(), UINT32_MAX);
+  std::vector<uint32_t> candidateTags(triangleCount, UINT32_MAX);
+  std::vector<uint32_t> candidates;
+
+  std::vector<uint32_t> reordered;
+  reordered.reserve(indices.size());
+
+  uint32_t scan = 0;
+  uint32_t emittedCount = 0;
+
+  while (emittedCount < triangleCount) {
+    uint32_t tag = meshlets.size();
+
+    Meshlet meshlet = {};
+    meshlet.firstIndex = reordered.size();
+    candidates.clear();
+
+    while (scan < triangleCount && emitted[scan]) {
+      scan++;
+    }
+    uint32_t next = scan;
+
+    while (true) {
+      uint32_t newVertices = 0;
+      for (uint32_t corner = 0; corner < 3; ++corner) {
+        newVertices += vertexTags[indices[next * 3 + corner]] != tag;
+      }
+
+      if (meshlet.vertexCount + newVertices > MAX_VERTICES ||
+          meshlet.indexCount / 3 + 1 > MAX_TRIANGLES) {
+        break;
+      }
+
+      emitted[next] = true;
+      emittedCount++;
+      meshlet.vertexCount += newVertices;
+      meshlet.indexCount += 3;
+
+      for (uint32_t corner = 0; corner < 3; ++corner) {
+        uint32_t index = indices[next * 3 + corner];
+        vertexTags[index] = tag;
+        reordered.push_back(index);
+
+        uint32_t position = positionIds[index];
+        for (uint32_t a = adjacencyOffsets[position];
+             a < adjacencyOffsets[position + 1]; ++a) {
+          uint32_t triangle = adjacency[a];
+
+          if (!emitted[triangle] && candidateTags[triangle] != tag) {
+            candidateTags[triangle] = tag;
+            candidates.push_back(triangle);
+          }
+        }
+      }
+
+      // Grow with the neighbour adding the fewest vertices
+      uint32_t best = UINT32_MAX;
+      uint32_t bestScore = UINT32_MAX;
+      for (size_t c = 0; c < candidates.size();) {
+        uint32_t triangle = candidates[c];
+
+        if (emitted[triangle]) {
+          candidates[c] = candidates.back();
+          candidates.pop_back();
+          continue;
+        }
+
+        uint32_t score = 0;
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+          score += vertexTags[indices[triangle * 3 + corner]] != tag;
+        }
+
+        if (score < bestScore) {
+          best = triangle;
+          bestScore = score;
+        }
+
+        c++;
+      }
+
+      // A meshlet ends with its connected patch
+      if (best == UINT32_MAX) {
+        break;
+      }
+
+      next = best;
+    }
+
+    computeBounds(vertices, reordered.data() + meshlet.firstIndex, meshlet);
+    meshlets.push_back(meshlet);
+  }
+
+  indices = std::move(reordered);
+}
+
+bool Meshlets::visible(const Meshlet &meshlet, const glm::mat4 &model,
+                       float scale, const Frustum &frustum,
+                       const glm::vec3 &camera, bool backFaces) {
+  glm::vec3 center =
+      glm::vec3(model * glm::vec4(glm::vec3(meshlet.sphere), 1.0f));
+  float radius = meshlet.sphere.w * scale;
+
+  for (const glm::vec4 &plane : frustum.planes) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+      return false;
+    }
+  }
+
+  // Faces turned away are rasterized when the cull mode is none
+  if (!backFaces) {
+    return true;
+  }
+
+  glm::vec3 axis = glm::normalize(
+      glm::vec3(model * glm::vec4(glm::vec3(meshlet.cone), 0.0f)));
+  glm::vec3 toCenter = center - camera;
+
+  return glm::dot(toCenter, axis) <
+         meshlet.cone.w * glm::length(toCenter) + radius;
+}
@@ -0,0 +1,41 @@
+#ifndef VULKAN_MESHLETS_H
+#define VULKAN_MESHLETS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "vertices.h"
+#include "culling.h"
+
+// Mirrors the Meshlet struct of cull.comp ( std430 ). A meshlet is a run of the
+// mesh's index buffer, drawn with its own indexed draw.
+struct Meshlet {
+  // Bounding sphere in model space, xyz center and w radius
+  glm::vec4 sphere;
+  // Normal cone, xyz axis and w the sine of its half angle, 1 never culls
+  glm::vec4 cone;
+  uint32_t  firstIndex;
+  uint32_t  indexCount;
+  uint32_t  vertexCount;
+  uint32_t  pad;
+};
+
+namespace Meshlets {
+  const uint32_t MAX_VERTICES  = 64;
+  const uint32_t MAX_TRIANGLES = 124;
+
+  // Vertices are split on UV seams, gives every vertex the id of its position
+  // and returns the number of distinct positions
+  uint32_t weldPositions( const std::vector< Vertex >& vertices, std::vector< uint32_t >& positionIds );
+
+  // Groups neighbouring triangles into meshlets and reorders indices so every
+  // meshlet is a contiguous range
+  void build( const std::vector< Vertex >& vertices, std::vector< uint32_t >& indices, std::vector< Meshlet >& meshlets );
+
+  // False when the meshlet is outside the frustum or, with backFaces, all its
+  // triangles face away from the camera. scale is the largest axis scale of
+  // model.
+  bool visible( const Meshlet& meshlet, const glm::mat4& model, float scale, const Frustum& frustum, const glm::vec3& camera, bool backFaces );
+}
+
+#endif //VULKAN_MESHLETS_H
@@ -0,0 +1,650 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "lod.h"
+
+#if OCCLUSION_SIMD_WIDTH > 1
+#include <immintrin.h>
+#endif
+
+// Vertices closer to the camera plane than this aren't projected
+static const float NEAR_W = 1e-4f;
+
+// Resolution the benchmark checks the culled objects at
+static const uint32_t REFERENCE_WIDTH = 1280;
+static const uint32_t REFERENCE_HEIGHT = 720;
+
+void SoftwareOcclusion::start(uint32_t workerCount) {
+  m_stopping = false;
+  m_bandCount = workerCount + 1;
+  m_depth.assign(WIDTH * HEIGHT, 1.0f);
+
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    m_workers.emplace_back(&SoftwareOcclusion::work, this, i + 1);
+  }
+}
+
+void SoftwareOcclusion::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_startSignal.notify_all();
+
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+
+  m_workers.clear();
+}
+
+void SoftwareOcclusion::begin(const glm::mat4 &viewProj) {
+  m_viewProj = viewProj;
+  m_triangles.clear();
+  std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+}
+
+void SoftwareOcclusion::addOccluder(const std::vector<glm::vec3> &positions,
+                                    const std::vector<uint32_t> &indices,
+                                    const glm::mat4 &model) {
+  glm::mat4 transform = m_viewProj * model;
+
+  m_clip.resize(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i) {
+    m_clip[i] = transform * glm::vec4(positions[i], 1.0f);
+  }
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    glm::vec3 screen[3];
+    bool clipped = false;
+
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      const glm::vec4 &clip = m_clip[indices[i + corner]];
+      if (clip.w < NEAR_W) {
+        clipped = true;
+        break;
+      }
+
+      screen[corner] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * WIDTH,
+                                 (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT,
+                                 clip.z / clip.w);
+    }
+
+    if (clipped) {
+      continue;
+    }
+
+    // Counter clockwise front faces have a negative area with y pointing down,
+    // swapped they give positive edge functions inside
+    float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                 (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+    if (area >= 0.0f) {
+      continue;
+    }
+
+    std::swap(screen[1], screen[2]);
+    area = -area;
+
+    float minX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+    float maxX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+    float minY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+    float maxY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+
+    Triangle triangle;
+    triangle.minX = (uint32_t)std::max(std::floor(minX), 0.0f);
+    triangle.maxX = (uint32_t)std::min(std::ceil(maxX), (float)WIDTH);
+    triangle.minY = (uint32_t)std::max(std::floor(minY), 0.0f);
+    triangle.maxY = (uint32_t)std::min(std::ceil(maxY), (float)HEIGHT);
+
+    if (maxX <= 0.0f || maxY <= 0.0f || triangle.minX >= triangle.maxX ||
+        triangle.minY >= triangle.maxY) {
+      continue;
+    }
+
+    for (uint32_t edge = 0; edge < 3; ++edge) {
+      const glm::vec3 &a = screen[edge];
+      const glm::vec3 &b = screen[(edge + 1) % 3];
+
+      triangle.edges[edge][0] = a.y - b.y;
+      triangle.edges[edge][1] = b.x - a.x;
+      triangle.edges[edge][2] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+    }
+
+    // Depth is affine in screen space after the perspective divide
+    float dx1 = screen[1].x - screen[0].x;
+    float dy1 = screen[1].y - screen[0].y;
+    float dz1 = screen[1].z - screen[0].z;
+    float dx2 = screen[2].x - screen[0].x;
+    float dy2 = screen[2].y - screen[0].y;
+    float dz2 = screen[2].z - screen[0].z;
+
+    triangle.depth[0] = (dz1 * dy2 - dz2 * dy1) / area;
+    triangle.depth[1] = (dx1 * dz2 - dx2 * dz1) / area;
+    triangle.depth[2] = screen[0].z - triangle.depth[0] * screen[0].x -
+                        triangle.depth[1] * screen[0].y;
+
+    m_triangles.push_back(triangle);
+  }
+}
+
+void SoftwareOcclusion::render() {
+  if (m_bandCount == 1) {
+    rasterize(0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_generation++;
+    m_pending = m_bandCount - 1;
+  }
+  m_startSignal.notify_all();
+
+  rasterize(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_doneSignal.wait(lock, [this]() { return m_pending == 0; });
+}
+
+void SoftwareOcclusion::work(uint32_t band) {
+  uint64_t generation = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_startSignal.wait(lock, [this, generation]() {
+        return m_stopping || m_generation != generation;
+      });
+
+      if (m_stopping) {
+        return;
+      }
+
+      generation = m_generation;
+    }
+
+    rasterize(band);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pending--;
+    }
+    m_doneSignal.notify_one();
+  }
+}
+
+void SoftwareOcclusion::rasterize(uint32_t band) {
+  uint32_t bandHeight = (HEIGHT + m_bandCount - 1) / m_bandCount;
+  uint32_t bandBegin = std::min(band * bandHeight, HEIGHT);
+  uint32_t bandEnd = std::min(bandBegin + bandHeight, HEIGHT);
+
+  for (const Triangle &triangle : m_triangles) {
+    uint32_t beginY = std::max(triangle.minY, bandBegin);
+    uint32_t endY = std::min(triangle.maxY, bandEnd);
+
+    for (uint32_t y = beginY; y < endY; ++y) {
+      float centerY = y + 0.5f;
+      float *row = &m_depth[y * WIDTH];
+
+      // Edge and depth values at the start of the row, minus the x term
+      float rowEdges[3];
+      for (uint32_t edge = 0; edge < 3; ++edge) {
+        rowEdges[edge] =
+            triangle.edges[edge][1] * centerY + triangle.edges[edge][2];
+      }
+      float rowDepth = triangle.depth[1] * centerY + triangle.depth[2];
+
+#if OCCLUSION_SIMD_WIDTH > 1
+      const __m256 lanes =
+          _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+
+      for (uint32_t x = triangle.minX & ~7u; x < triangle.maxX; x += 8) {
+        __m256 centerX = _mm256_add_ps(_mm256_set1_ps((float)x), lanes);
+
+        __m256 e0 = _mm256_fmadd_ps(_mm256_set1_ps(triangle.edges[0][0]),
+                                    centerX, _mm256_set1_ps(rowEdges[0]));
+        __m256 e1 = _mm256_fmadd_ps(_mm256_set1_ps(triangle.edges[1][0]),
+                                    centerX, _mm256_set1_ps(rowEdges[1]));
+        __m256 e2 = _mm256_fmadd_ps(_mm256_set1_ps(triangle.edges[2][0]),
+                                    centerX, _mm256_set1_ps(rowEdges[2]));
+
+        // The sign bit is set on lanes where any edge is negative
+        __m256 outside = _mm256_or_ps(_mm256_or_ps(e0, e1), e2);
+        if (_mm256_movemask_ps(outside) == 0xFF) {
+          continue;
+        }
+
+        __m256 depth = _mm256_fmadd_ps(_mm256_set1_ps(triangle.depth[0]),
+                                       centerX, _mm256_set1_ps(rowDepth));
+        __m256 stored = _mm256_loadu_ps(row + x);
+        __m256 closer = _mm256_min_ps(stored, depth);
+
+        _mm256_storeu_ps(row + x, _mm256_blendv_ps(closer, stored, outside));
+      }
+#else
+      for (uint32_t x = triangle.minX; x < triangle.maxX; ++x) {
+        float centerX = x + 0.5f;
+
+        if (triangle.edges[0][0] * centerX + rowEdges[0] < 0.0f ||
+            triangle.edges[1][0] * centerX + rowEdges[1] < 0.0f ||
+            triangle.edges[2][0] * centerX + rowEdges[2] < 0.0f) {
+          continue;
+        }
+
+        row[x] = std::min(row[x], triangle.depth[0] * centerX + rowDepth);
+      }
+#endif
+    }
+  }
+}
+
+bool SoftwareOcclusion::visible(const glm::vec3 &min,
+                                const glm::vec3 &max) const {
+  float minX = FLT_MAX;
+  float maxX = -FLT_MAX;
+  float minY = FLT_MAX;
+  float maxY = -FLT_MAX;
+  float nearest = 1.0f;
+
+  for (uint32_t i = 0; i < 8; ++i) {
+    glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y,
+                     (i & 4) ? max.z : min.z);
+    glm::vec4 clip = m_viewProj * glm::vec4(corner, 1.0f);
+
+    // Crossing the camera plane, the projection is unbounded
+    if (clip.w < NEAR_W) {
+      return true;
+    }
+
+    float x = (clip.x / clip.w * 0.5f + 0.5f) * WIDTH;
+    float y = (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT;
+
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
+    nearest = std::min(nearest, clip.z / clip.w);
+  }
+
+  if (nearest <= 0.0f) {
+    return true;
+  }
+
+  int beginX = std::max((int)std::floor(minX), 0);
+  int endX = std::min((int)std::ceil(maxX), (int)WIDTH);
+  int beginY = std::max((int)std::floor(minY), 0);
+  int endY = std::min((int)std::ceil(maxY), (int)HEIGHT);
+
+  for (int y = beginY; y < endY; ++y) {
+    const float *row = &m_depth[y * WIDTH];
+
+#if OCCLUSION_SIMD_WIDTH > 1
+    __m256 reference = _mm256_set1_ps(nearest);
+
+    for (int x = beginX & ~7; x < endX; x += 8) {
+      __m256 stored = _mm256_loadu_ps(row + x);
+      uint32_t farther =
+          _mm256_movemask_ps(_mm256_cmp_ps(stored, reference, _CMP_GT_OQ));
+
+      // Only the lanes inside the box count
+      uint32_t inside = 0xFF;
+      if (x < beginX) {
+        inside &= 0xFF << (beginX - x);
+      }
+      if (x + 8 > endX) {
+        inside &= 0xFF >> (x + 8 - endX);
+      }
+
+      if (farther & inside) {
+        return true;
+      }
+    }
+#else
+    for (int x = beginX; x < endX; ++x) {
+      if (row[x] > nearest) {
+        return true;
+      }
+    }
+#endif
+  }
+
+  return false;
+}
+
+// Triangles of an axis aligned box, counter clockwise seen from outside
+static void appendBox(const glm::vec3 &min, const glm::vec3 &max,
+                      std::vector<glm::vec3> &positions,
+                      std::vector<uint32_t> &indices) {
+  const uint32_t faces[6][4] = {{0, 4, 6, 2}, {1, 3, 7, 5}, {0, 1, 5, 4},
+                                {2, 6, 7, 3}, {0, 2, 3, 1}, {4, 5, 7, 6}};
+
+  uint32_t base = positions.size();
+  for (uint32_t i = 0; i < 8; ++i) {
+    positions.push_back(glm::vec3((i & 1) ? max.x : min.x,
+                                  (i & 2) ? max.y : min.y,
+                                  (i & 4) ? max.z : min.z));
+  }
+
+  for (const uint32_t *face : faces) {
+    indices.insert(indices.end(), {base + face[0], base + face[1],
+                                   base + face[2], base + face[0],
+                                   base + face[2], base + face[3]});
+  }
+}
+
+// Sphere made of a cube whose faces are split into resolution x resolution
+// quads, counter clockwise seen from outside. Texture coordinates are all 0 so
+// no vertex is split and the whole mesh can be simplified.
+static void buildTestMesh(uint32_t resolution, std::vector<Vertex> &vertices,
+                          std::vector<uint32_t> &indices) {
+  std::unordered_map<uint64_t, uint32_t> welded;
+  auto vertex = [&](const glm::uvec3 &point) {
+    uint64_t key = (uint64_t)point.x << 42 | (uint64_t)point.y << 21 | point.z;
+    auto inserted = welded.emplace(key, (uint32_t)vertices.size());
+    if (inserted.second) {
+      Vertex added = {};
+      added.pos = glm::normalize(glm::vec3(point) / (float)resolution * 2.0f -
+                                 glm::vec3(1.0f));
+      added.color = glm::vec3(1.0f);
+      vertices.push_back(added);
+    }
+    return inserted.first->second;
+  };
+
+  for (uint32_t axis = 0; axis < 3; ++axis) {
+    uint32_t u = (axis + 1) % 3;
+    uint32_t v = (axis + 2) % 3;
+
+    for (uint32_t side = 0; side < 2; ++side) {
+      for (uint32_t i = 0; i < resolution; ++i) {
+        for (uint32_t j = 0; j < resolution; ++j) {
+          uint32_t corners[4];
+          for (uint32_t corner = 0; corner < 4; ++corner) {
+            glm::uvec3 point;
+            point[axis] = side * resolution;
+            point[u] = i + (corner == 1 || corner == 2);
+            point[v] = j + (corner >= 2);
+            corners[corner] = vertex(point);
+          }
+
+          // u x v points along the axis, the negative side is wound the
+          // other way
+          if (side == 1) {
+            indices.insert(indices.end(), {corners[0], corners[1], corners[2],
+                                           corners[0], corners[2], corners[3]});
+          } else {
+            indices.insert(indices.end(), {corners[0], corners[2], corners[1],
+                                           corners[0], corners[3], corners[2]});
+          }
+        }
+      }
+    }
+  }
+}
+
+// Plain rasterizer at the reference resolution, pixel centers inside the
+// triangle take its interpolated depth. Either keeps the nearest depth, or
+// reports whether any pixel is nearer than the one stored.
+static bool rasterizeReference(const glm::vec4 *clip,
+                               std::vector<float> &depth, bool write) {
+  glm::vec3 screen[3];
+  for (uint32_t i = 0; i < 3; ++i) {
+    // Never happens in the test scene, counted as visible to stay safe
+    if (clip[i].w < NEAR_W) {
+      return !write;
+    }
+    glm::vec3 ndc = glm::vec3(clip[i]) / clip[i].w;
+    screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * REFERENCE_WIDTH,
+                          (ndc.y * 0.5f + 0.5f) * REFERENCE_HEIGHT, ndc.z);
+  }
+
+  float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+               (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+  if (area == 0.0f) {
+    return false;
+  }
+
+  int beginX = std::max(
+      (int)std::floor(std::min({screen[0].x, screen[1].x, screen[2].x})), 0);
+  int endX = std::min(
+      (int)std::ceil(std::max({screen[0].x, screen[1].x, screen[2].x})),
+      (int)REFERENCE_WIDTH);
+  int beginY = std::max(
+      (int)std::floor(std::min({screen[0].y, screen[1].y, screen[2].y})), 0);
+  int endY = std::min(
+      (int)std::ceil(std::max({screen[0].y, screen[1].y, screen[2].y})),
+      (int)REFERENCE_HEIGHT);
+
+  for (int y = beginY; y < endY; ++y) {
+    for (int x = beginX; x < endX; ++x) {
+      glm::vec2 center(x + 0.5f, y + 0.5f);
+
+      // Barycentric weights, all positive inside whatever the winding
+      float weights[3];
+      bool inside = true;
+      for (uint32_t i = 0; i < 3; ++i) {
+        const glm::vec3 &a = screen[(i + 1) % 3];
+        const glm::vec3 &b = screen[(i + 2) % 3];
+        weights[i] = ((b.x - a.x) * (center.y - a.y) -
+                      (b.y - a.y) * (center.x - a.x)) /
+                     area;
+        inside = inside && weights[i] >= 0.0f;
+      }
+      if (!inside) {
+        continue;
+      }
+
+      float z = weights[0] * screen[0].z + weights[1] * screen[1].z +
+                weights[2] * screen[2].z;
+      float &stored = depth[y * REFERENCE_WIDTH + x];
+      if (write) {
+        stored = std::min(stored, z);
+      } else if (z < stored) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool SoftwareOcclusion::benchmark(uint32_t objectCount) {
+  typedef std::chrono::high_resolution_clock Clock;
+
+  const uint32_t FRAME_COUNT = 100;
+
+  // Every prop is the same sphere with its LOD chain, picked per object like
+  // the renderer does
+  std::vector<Vertex> meshVertices;
+  std::vector<uint32_t> meshIndices;
+  std::vector<Meshlet> meshlets;
+  std::vector<MeshLod> lods;
+  buildTestMesh(16, meshVertices, meshIndices);
+  Lod::build(meshVertices, meshIndices, meshlets, lods);
+
+  // A street of walls with narrow gaps and blocks of buildings behind it, a
+  // field of props between them
+  std::mt19937 random(1337);
+  std::uniform_real_distribution<float> height(6.0f, 30.0f);
+
+  std::vector<glm::vec3> occluderPositions;
+  std::vector<uint32_t> occluderIndices;
+  for (float x = -60.0f; x < 60.0f; x += 14.0f) {
+    appendBox(glm::vec3(x, 0.0f, -16.0f), glm::vec3(x + 12.0f, 8.0f, -15.0f),
+              occluderPositions, occluderIndices);
+  }
+  for (float z = -40.0f; z > -300.0f; z -= 20.0f) {
+    for (float x = -150.0f; x < 150.0f; x += 20.0f) {
+      appendBox(glm::vec3(x, 0.0f, z - 12.0f),
+                glm::vec3(x + 12.0f, height(random), z),
+                occluderPositions, occluderIndices);
+    }
+  }
+
+  std::uniform_real_distribution<float> spreadX(-150.0f, 150.0f);
+  std::uniform_real_distribution<float> spreadZ(-300.0f, -20.0f);
+  std::uniform_real_distribution<float> size(0.5f, 2.0f);
+
+  glm::vec3 camera(0.0f, 2.0f, 0.0f);
+  glm::mat4 view = glm::lookAt(camera, glm::vec3(0.0f, 2.0f, -1.0f),
+                               glm::vec3(0.0f, 1.0f, 0.0f));
+  glm::mat4 proj =
+      glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+  proj[1][1] *= -1;
+  glm::mat4 viewProj = proj * view;
+  float pixelsPerUnit = std::abs(proj[1][1]) * REFERENCE_HEIGHT * 0.5f;
+
+  // The spheres fill their boxes
+  std::vector<glm::vec3> mins(objectCount);
+  std::vector<glm::vec3> maxs(objectCount);
+  std::vector<glm::mat4> models(objectCount);
+  std::vector<uint32_t> levels(objectCount);
+  for (uint32_t i = 0; i < objectCount; ++i) {
+    glm::vec3 extent(size(random), size(random), size(random));
+    glm::vec3 center(spreadX(random), extent.y, spreadZ(random));
+
+    mins[i] = center - extent;
+    maxs[i] = center + extent;
+    models[i] = glm::scale(glm::translate(glm::mat4(1.0f), center), extent);
+
+    float scale = std::max(extent.x, std::max(extent.y, extent.z));
+    float distance = glm::length(center - camera) - scale;
+    levels[i] = Lod::select(lods, scale, distance, pixelsPerUnit, 1.0f);
+  }
+
+  AabbSoA boxes;
+  std::vector<uint32_t> ids;
+  for (uint32_t i = 0; i < objectCount; ++i) {
+    boxes.push(mins[i], maxs[i]);
+    ids.push_back(i);
+  }
+  while (boxes.size() % Culling::SLOT_ALIGNMENT != 0) {
+    boxes.pushEmpty();
+    ids.push_back(UINT32_MAX);
+  }
+
+  std::vector<uint32_t> inFrustum;
+  Culling::cullSimd(Frustum::fromMatrix(viewProj), boxes, ids.data(), 0,
+                    boxes.size(), inFrustum);
+
+  printf("Software occlusion, %u objects, %dx%d depth, %d wide SIMD\n",
+         objectCount, WIDTH, HEIGHT, OCCLUSION_SIMD_WIDTH);
+
+  uint32_t cores = std::thread::hardware_concurrency();
+  uint32_t workerCounts[2] = {0, cores > 1 ? cores - 1 : 0};
+  std::vector<uint32_t> occluded;
+
+  for (uint32_t workers : workerCounts) {
+    SoftwareOcclusion occlusion;
+    occlusion.start(workers);
+
+    double rasterTime = 0.0;
+    double testTime = 0.0;
+
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame) {
+      Clock::time_point start = Clock::now();
+      occlusion.begin(viewProj);
+      occlusion.addOccluder(occluderPositions, occluderIndices,
+                            glm::mat4(1.0f));
+      occlusion.render();
+      rasterTime += std::chrono::duration<double, std::milli>(Clock::now() -
+                                                               start)
+                        .count();
+
+      start = Clock::now();
+      occluded.clear();
+      for (uint32_t id : inFrustum) {
+        if (!occlusion.visible(mins[id], maxs[id])) {
+          occluded.push_back(id);
+        }
+      }
+      testTime += std::chrono::duration<double, std::milli>(Clock::now() -
+                                                             start)
+                      .count();
+    }
+
+    occlusion.stop();
+
+    printf("  %2u threads: %8.3f ms rasterizing %u triangles, %8.3f ms "
+           "testing\n",
+           workers + 1, rasterTime / FRAME_COUNT, occlusion.triangleCount(),
+           testTime / FRAME_COUNT);
+  }
+
+  // Triangles of the level each object would be drawn with
+  std::vector<bool> hidden(objectCount, false);
+  for (uint32_t id : occluded) {
+    hidden[id] = true;
+  }
+
+  uint64_t frustumTriangles = 0;
+  uint64_t occludedTriangles = 0;
+  for (uint32_t id : inFrustum) {
+    uint64_t triangles = lods[levels[id]].indexCount / 3;
+    frustumTriangles += triangles;
+    occludedTriangles += hidden[id] ? 0 : triangles;
+  }
+
+  size_t visibleCount = inFrustum.size() - occluded.size();
+  printf("  Frustum culling:   %6zu objects, %10llu triangles submitted\n",
+         inFrustum.size(), (unsigned long long)frustumTriangles);
+  printf("  Occlusion culling: %6zu objects, %10llu triangles submitted "
+         "( %.1f%% fewer )\n",
+         visibleCount, (unsigned long long)occludedTriangles,
+         frustumTriangles == 0
+             ? 0.0
+             : 100.0 * (frustumTriangles - occludedTriangles) /
+                   frustumTriangles);
+
+  // Every culled object's full mesh is drawn against the scene's depth at
+  // full resolution, a single nearer pixel means it was visible
+  std::vector<float> reference(REFERENCE_WIDTH * REFERENCE_HEIGHT, 1.0f);
+  for (size_t i = 0; i < occluderIndices.size(); i += 3) {
+    glm::vec4 clip[3];
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      clip[corner] = viewProj *
+                     glm::vec4(occluderPositions[occluderIndices[i + corner]],
+                               1.0f);
+    }
+    rasterizeReference(clip, reference, true);
+  }
+
+  uint32_t falseRejections = 0;
+  uint32_t firstRejection = UINT32_MAX;
+  for (uint32_t id : occluded) {
+    glm::mat4 modelViewProj = viewProj * models[id];
+
+    bool visible = false;
+    for (uint32_t i = 0; i < lods[0].indexCount && !visible; i += 3) {
+      glm::vec4 clip[3];
+      for (uint32_t corner = 0; corner < 3; ++corner) {
+        uint32_t index = meshIndices[lods[0].firstIndex + i + corner];
+        clip[corner] =
+            modelViewProj * glm::vec4(glm::vec3(meshVertices[index].pos), 1.0f);
+      }
+      visible = rasterizeReference(clip, reference, false);
+    }
+
+    if (visible) {
+      falseRejections++;
+      firstRejection = std::min(firstRejection, id);
+    }
+  }
+
+  printf("  Checked at %ux%u: %u of %zu culled objects were visible\n",
+         REFERENCE_WIDTH, REFERENCE_HEIGHT, falseRejections, occluded.size());
+  if (falseRejections > 0) {
+    printf("ERROR: Object %u was culled but is visible\n", firstRejection);
+  }
+
+  return falseRejections == 0;
+}
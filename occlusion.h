@@ -0,0 +1,80 @@
+#ifndef VULKAN_OCCLUSION_H
+#define VULKAN_OCCLUSION_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "culling.h"
+
+// Occluders drawn per instruction, picked from what the compiler targets
+#if defined( __AVX2__ ) && defined( __FMA__ )
+#define OCCLUSION_SIMD_WIDTH 8
+#else
+#define OCCLUSION_SIMD_WIDTH 1
+#endif
+
+// Coarse depth buffer the biggest objects are rasterized into on the CPU, the
+// rest is tested against it before reaching the draw list. Rows are split in
+// bands, one per thread, and every thread rasterizes all triangles clipped to
+// its band so no pixel is shared.
+class SoftwareOcclusion {
+public:
+  static const uint32_t WIDTH  = 256;
+  static const uint32_t HEIGHT = 128;
+
+  // The calling thread draws a band too, 0 workers rasterizes on it alone
+  void start( uint32_t workerCount );
+  void stop();
+
+  // Clears the depth buffer and drops the previous occluders
+  void begin( const glm::mat4& viewProj );
+  // Positions are in model space. Back faces like the main pipeline's and
+  // triangles crossing the near plane are dropped, which only loses occlusion.
+  void addOccluder( const std::vector< glm::vec3 >& positions, const std::vector< uint32_t >& indices, const glm::mat4& model );
+  void render();
+
+  // False when every pixel the box covers holds a nearer occluder
+  bool visible( const glm::vec3& min, const glm::vec3& max ) const;
+
+  uint32_t triangleCount() const { return m_triangles.size(); }
+
+  // Renders a test scene of walls in front of a field of LOD meshes and
+  // reports the triangles of their picked levels submitted and timings with
+  // and without the workers. Culled objects are checked against a full
+  // resolution depth buffer, false when any of them is visible.
+  static bool benchmark( uint32_t objectCount );
+
+private:
+  // Edge functions and depth plane in pixels, a pixel is inside when all three
+  // edges are positive at its center
+  struct Triangle {
+    float    edges[ 3 ][ 3 ];
+    float    depth[ 3 ];
+    uint32_t minX;
+    uint32_t maxX;
+    uint32_t minY;
+    uint32_t maxY;
+  };
+
+  void work( uint32_t band );
+  void rasterize( uint32_t band );
+
+  glm::mat4                m_viewProj;
+  std::vector< float >     m_depth;
+  std::vector< Triangle >  m_triangles;
+  std::vector< glm::vec4 > m_clip;
+
+  std::vector< std::thread > m_workers;
+  std::mutex                 m_mutex;
+  std::condition_variable    m_startSignal;
+  std::condition_variable    m_doneSignal;
+  uint64_t                   m_generation = 0;
+  uint32_t                   m_pending    = 0;
+  uint32_t                   m_bandCount  = 1;
+  bool                       m_stopping   = false;
+};
+
+#endif //VULKAN_OCCLUSION_H
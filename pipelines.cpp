@@ -0,0 +1,82 @@
+#include "pipelines.h"
+
+#include "utils.h"
+
+void PipelineCompiler::start(VkDevice device, uint32_t workerCount) {
+  m_device = device;
+  m_stopping = false;
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+  VK_CHECK(vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_cache),
+           "Creating pipeline cache");
+
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    m_workers.emplace_back(&PipelineCompiler::work, this);
+  }
+}
+
+void PipelineCompiler::stop() {
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_buildSignal.notify_all();
+
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+
+  m_workers.clear();
+  vkDestroyPipelineCache(m_device, m_cache, nullptr);
+}
+
+std::shared_future<VkPipeline> PipelineCompiler::compile(Build build) {
+  Task task(std::move(build));
+  std::shared_future<VkPipeline> pipeline = task.get_future().share();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_builds.push_back(std::move(task));
+  }
+  m_buildSignal.notify_one();
+
+  return pipeline;
+}
+
+void PipelineCompiler::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idleSignal.wait(lock,
+                    [this]() { return m_builds.empty() && m_running == 0; });
+}
+
+void PipelineCompiler::work() {
+  while (true) {
+    Task build;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_buildSignal.wait(lock,
+                         [this]() { return m_stopping || !m_builds.empty(); });
+
+      if (m_stopping) {
+        return;
+      }
+
+      build = std::move(m_builds.front());
+      m_builds.pop_front();
+      m_running++;
+    }
+
+    build(m_cache);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running--;
+    }
+    m_idleSignal.notify_all();
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef VULKAN_PIPELINES_H
+#define VULKAN_PIPELINES_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+// Builds pipelines on a pool of worker threads. Every build goes through one
+// shared VkPipelineCache, which Vulkan synchronizes internally, and hands its
+// pipeline back through a future. Whatever a build reads must stay untouched
+// until wait() returns.
+class PipelineCompiler {
+public:
+  typedef std::function< VkPipeline( VkPipelineCache ) > Build;
+
+  void start( VkDevice device, uint32_t workerCount );
+  // Finishes the queued builds, the pipelines belong to whoever queued them
+  void stop();
+
+  std::shared_future< VkPipeline > compile( Build build );
+  // Until the queue is empty and no build is running
+  void wait();
+
+private:
+  typedef std::packaged_task< VkPipeline( VkPipelineCache ) > Task;
+
+  void work();
+
+  VkDevice        m_device;
+  VkPipelineCache m_cache = VK_NULL_HANDLE;
+
+  std::vector< std::thread > m_workers;
+  std::deque< Task >         m_builds;
+  std::mutex                 m_mutex;
+  std::condition_variable    m_buildSignal;
+  std::condition_variable    m_idleSignal;
+  uint32_t                   m_running  = 0;
+  bool                       m_stopping = false;
+};
+
+#endif //VULKAN_PIPELINES_H
@@ -0,0 +1,138 @@
+#include "residency.h"
+
+#include <algorithm>
+
+void TextureResidency::create(
+    VkPhysicalDevice physicalDevice,
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2,
+    VkDeviceSize budget) {
+  m_physicalDevice = physicalDevice;
+  m_getMemoryProperties2 = getMemoryProperties2;
+  m_budget = budget;
+  m_usage = 0;
+  m_entries.clear();
+}
+
+void TextureResidency::track(TextureHandle handle, VkDeviceSize bytes,
+                             uint32_t mipLevels, uint64_t frame) {
+  if (handle >= m_entries.size()) {
+    m_entries.resize(handle + 1, {0, 0, 0, false});
+  }
+
+  Entry &entry = m_entries[handle];
+  if (entry.tracked) {
+    m_usage -= entry.bytes;
+  }
+
+  // Resizing an entry keeps its age, only new entries count as used
+  if (!entry.tracked) {
+    entry.lastUsed = std::max(entry.lastUsed, frame);
+  }
+
+  entry.bytes = bytes;
+  entry.mipLevels = mipLevels;
+  entry.tracked = true;
+
+  m_usage += bytes;
+}
+
+void TextureResidency::untrack(TextureHandle handle) {
+  if (handle >= m_entries.size() || !m_entries[handle].tracked) {
+    return;
+  }
+
+  m_usage -= m_entries[handle].bytes;
+  m_entries[handle].tracked = false;
+}
+
+void TextureResidency::touch(TextureHandle handle, uint64_t frame) {
+  if (handle < m_entries.size()) {
+    m_entries[handle].lastUsed = frame;
+  }
+}
+
+VkDeviceSize TextureResidency::deviceLimit() {
+  if (m_getMemoryProperties2 == nullptr) {
+    return UINT64_MAX;
+  }
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+  budgetProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2KHR memProperties = {};
+  memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+  memProperties.pNext = &budgetProperties;
+
+  m_getMemoryProperties2(m_physicalDevice, &memProperties);
+
+  VkDeviceSize limit = UINT64_MAX;
+  const VkPhysicalDeviceMemoryProperties &heaps =
+      memProperties.memoryProperties;
+
+  for (uint32_t i = 0; i < heaps.memoryHeapCount; ++i) {
+    if (!(heaps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+      continue;
+    }
+
+    // Leave some headroom for everything that is not a texture
+    VkDeviceSize heapLimit = budgetProperties.heapBudget[i] / 10 * 9;
+    VkDeviceSize heapUsage = budgetProperties.heapUsage[i];
+
+    if (heapUsage > heapLimit) {
+      VkDeviceSize overshoot = heapUsage - heapLimit;
+      limit = std::min(limit, m_usage > overshoot ? m_usage - overshoot : 0);
+    }
+  }
+
+  return limit;
+}
+
+VkDeviceSize TextureResidency::effectiveBudget() {
+  return std::min(m_budget, deviceLimit());
+}
+
+std::vector<ResidencyAction> TextureResidency::collect(uint64_t frame,
+                                                       uint64_t safeFrames) {
+  std::vector<ResidencyAction> actions;
+
+  VkDeviceSize limit = effectiveBudget();
+  if (m_usage <= limit) {
+    return actions;
+  }
+
+  std::vector<TextureHandle> candidates;
+  for (TextureHandle handle = 0; handle < m_entries.size(); ++handle) {
+    const Entry &entry = m_entries[handle];
+
+    if (entry.tracked && entry.lastUsed + safeFrames < frame) {
+      candidates.push_back(handle);
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [this](TextureHandle a, TextureHandle b) {
+              return m_entries[a].lastUsed < m_entries[b].lastUsed;
+            });
+
+  // Sizes are estimated here, the renderer reports the real ones with track()
+  VkDeviceSize usage = m_usage;
+  for (TextureHandle handle : candidates) {
+    if (usage <= limit) {
+      break;
+    }
+
+    const Entry &entry = m_entries[handle];
+
+    if (entry.mipLevels > 1) {
+      // The top level holds roughly three quarters of the chain
+      actions.push_back({handle, entry.mipLevels - 1});
+      usage -= entry.bytes / 4 * 3;
+    } else {
+      actions.push_back({handle, 0});
+      usage -= entry.bytes;
+    }
+  }
+
+  return actions;
+}
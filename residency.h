@@ -0,0 +1,56 @@
+#ifndef VULKAN_RESIDENCY_H
+#define VULKAN_RESIDENCY_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "streaming.h"
+
+struct ResidencyAction {
+  TextureHandle handle;
+  // Number of mip levels to keep, 0 evicts the whole texture
+  uint32_t      keepMipLevels;
+};
+
+// Keeps the GPU bytes of streamed textures under a budget. The renderer reports
+// sizes with track() and use with touch(), collect() then picks the least
+// recently used textures to shrink or evict. When VK_EXT_memory_budget is
+// available the device local heaps' own budget caps the configured one.
+class TextureResidency {
+public:
+  void create( VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2, VkDeviceSize budget );
+
+  void setBudget( VkDeviceSize budget ) { m_budget = budget; }
+  void track( TextureHandle handle, VkDeviceSize bytes, uint32_t mipLevels, uint64_t frame );
+  void untrack( TextureHandle handle );
+  void touch( TextureHandle handle, uint64_t frame );
+
+  // Textures used during the last safeFrames frames are never picked
+  std::vector< ResidencyAction > collect( uint64_t frame, uint64_t safeFrames );
+
+  VkDeviceSize usage() const { return m_usage; }
+  VkDeviceSize budget() const { return m_budget; }
+  // The configured budget capped by the device local heaps' one
+  VkDeviceSize effectiveBudget();
+
+private:
+  struct Entry {
+    VkDeviceSize bytes;
+    uint32_t     mipLevels;
+    uint64_t     lastUsed;
+    bool         tracked;
+  };
+
+  VkDeviceSize deviceLimit();
+
+  VkPhysicalDevice                            m_physicalDevice       = VK_NULL_HANDLE;
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_getMemoryProperties2 = nullptr;
+
+  std::vector< Entry > m_entries;
+  VkDeviceSize         m_budget = 0;
+  VkDeviceSize         m_usage  = 0;
+};
+
+#endif //VULKAN_RESIDENCY_H
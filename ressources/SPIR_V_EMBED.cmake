@@ -0,0 +1,22 @@
+# Writes the SPIR-V words of INPUT to OUTPUT as a constexpr uint32_t array
+# named SYMBOL. Run with cmake -DINPUT=... -DOUTPUT=... -DSYMBOL=... -P
+file( READ ${INPUT} CONTENT HEX )
+
+string( LENGTH "${CONTENT}" CONTENT_LENGTH )
+math( EXPR REMAINDER "${CONTENT_LENGTH} % 8" )
+if( CONTENT_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0 )
+  message( FATAL_ERROR "${INPUT} is not a SPIR-V binary" )
+endif()
+
+# SPIR-V is little endian, the bytes of every word are flipped into a literal
+string( REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " WORDS "${CONTENT}" )
+# Six words a line, the regex flavour of cmake has no repetition counts
+set( WORD "0x........, " )
+string( REGEX REPLACE "(${WORD}${WORD}${WORD}${WORD}${WORD}${WORD})" "\\1\n" WORDS "${WORDS}" )
+string( REGEX REPLACE " \n" "\n  " WORDS "${WORDS}" )
+string( REGEX REPLACE "[ \n]+$" "" WORDS "${WORDS}" )
+
+file( WRITE ${OUTPUT}
+      "// Generated from ${INPUT}, do not edit\n"
+      "#include <cstdint>\n\n"
+      "constexpr uint32_t ${SYMBOL}[] = {\n  ${WORDS}\n};\n" )
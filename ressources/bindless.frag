@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Material features, set per pipeline or read from the object by the generic one
+layout( constant_id = 1 ) const bool TEXTURE          = true;
+layout( constant_id = 2 ) const bool RUNTIME_FEATURES = false;
+
+layout( set = 1, binding = 0 ) uniform sampler2D textures[];
+
+layout( location = 0 ) in vec3 fragColor;
+layout( location = 1 ) in vec2 fragTexCoord;
+layout( location = 2 ) flat in uint fragTextureIndex;
+layout( location = 3 ) flat in uint fragFeatures;
+
+layout( location = 0 ) out vec4 outColor;
+
+void main() {
+    vec3 color = fragColor;
+    if (RUNTIME_FEATURES ? ( fragFeatures & 2u ) != 0u : TEXTURE) {
+        color *= texture(textures[nonuniformEXT(fragTextureIndex)], fragTexCoord).rgb;
+    }
+    outColor = vec4(color, 1.0);
+}
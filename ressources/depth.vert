@@ -0,0 +1,48 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+struct Object {
+    mat4 model;
+    uint batch;
+    uint textureIndex;
+    uint color;
+    uint features;
+};
+
+layout( binding = 0 ) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout( std430, binding = 2 ) readonly buffer Objects {
+    Object objects[];
+};
+
+// Same block as triangle.vert, the pipelines share their layout
+layout( push_constant ) uniform Draw {
+    uint   pushed;
+    Object object;
+} draw;
+
+#ifdef VERTEX_PULLING
+// Position stream of the geometry pool, read like triangle.vert does
+layout( std430, binding = 3 ) readonly buffer Positions {
+    float positions[];
+};
+#else
+layout( location = 0 ) in vec3 inPosition;
+#endif
+
+// Same expression as triangle.vert, the color pass tests its depth for equality
+invariant gl_Position;
+
+void main() {
+#ifdef VERTEX_PULLING
+    uint p          = uint( gl_VertexIndex ) * 3;
+    vec3 inPosition = vec3( positions[p], positions[p + 1], positions[p + 2] );
+#endif
+
+    Object object = draw.pushed != 0u ? draw.object : objects[gl_InstanceIndex];
+
+    gl_Position = ubo.proj * ubo.view * object.model * vec4( inPosition, 1.0 );
+}
@@ -0,0 +1,452 @@
+// Build tool, reads a SPIR-V module and writes its descriptor bindings, push
+// constant size and vertex inputs as constexpr tables for shaders.h.
+// Usage: spirv_reflect <input.spv> <output.h> <symbol>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+// The few parts of the SPIR-V grammar reflection needs
+enum Op {
+  OP_ENTRY_POINT = 15,
+  OP_TYPE_BOOL = 20,
+  OP_TYPE_INT = 21,
+  OP_TYPE_FLOAT = 22,
+  OP_TYPE_VECTOR = 23,
+  OP_TYPE_MATRIX = 24,
+  OP_TYPE_IMAGE = 25,
+  OP_TYPE_SAMPLER = 26,
+  OP_TYPE_SAMPLED_IMAGE = 27,
+  OP_TYPE_ARRAY = 28,
+  OP_TYPE_RUNTIME_ARRAY = 29,
+  OP_TYPE_STRUCT = 30,
+  OP_TYPE_POINTER = 32,
+  OP_CONSTANT = 43,
+  OP_VARIABLE = 59,
+  OP_DECORATE = 71,
+  OP_MEMBER_DECORATE = 72,
+};
+
+enum Decoration {
+  DECORATION_BLOCK = 2,
+  DECORATION_BUFFER_BLOCK = 3,
+  DECORATION_ARRAY_STRIDE = 6,
+  DECORATION_MATRIX_STRIDE = 7,
+  DECORATION_BUILT_IN = 11,
+  DECORATION_LOCATION = 30,
+  DECORATION_BINDING = 33,
+  DECORATION_DESCRIPTOR_SET = 34,
+  DECORATION_OFFSET = 35,
+};
+
+enum StorageClass {
+  STORAGE_UNIFORM_CONSTANT = 0,
+  STORAGE_INPUT = 1,
+  STORAGE_UNIFORM = 2,
+  STORAGE_PUSH_CONSTANT = 9,
+  STORAGE_STORAGE_BUFFER = 12,
+};
+
+const uint32_t SPIRV_MAGIC = 0x07230203;
+const uint32_t DIM_BUFFER = 5;
+const uint32_t NOT_DECORATED = UINT32_MAX;
+
+struct Instruction {
+  uint32_t opcode;
+  std::vector<uint32_t> operands;
+};
+
+struct Binding {
+  uint32_t set;
+  uint32_t binding;
+  std::string type;
+  uint32_t count;
+};
+
+struct Input {
+  uint32_t location;
+  std::string format;
+};
+
+static void fail(const char *message, const char *path) {
+  printf("ERROR: %s: %s\n", path, message);
+  exit(EXIT_FAILURE);
+}
+
+class Module {
+public:
+  explicit Module(const std::vector<uint32_t> &words) {
+    for (size_t i = 5; i < words.size();) {
+      uint32_t count = words[i] >> 16;
+      if (count == 0 || i + count > words.size()) {
+        m_valid = false;
+        return;
+      }
+
+      Instruction instruction;
+      instruction.opcode = words[i] & 0xffff;
+      instruction.operands.assign(words.begin() + i + 1,
+                                  words.begin() + i + count);
+      i += count;
+
+      const std::vector<uint32_t> &operands = instruction.operands;
+      if (instruction.opcode == OP_DECORATE && operands.size() >= 2) {
+        m_decorations[operands[0]][operands[1]] =
+            operands.size() > 2 ? operands[2] : 0;
+      } else if (instruction.opcode == OP_MEMBER_DECORATE &&
+                 operands.size() >= 3) {
+        m_memberDecorations[operands[0]][operands[1]][operands[2]] =
+            operands.size() > 3 ? operands[3] : 0;
+      } else if (instruction.opcode == OP_ENTRY_POINT && !operands.empty()) {
+        m_executionModel = operands[0];
+      } else if (instruction.opcode == OP_VARIABLE && operands.size() >= 3) {
+        m_variables.push_back(operands[1]);
+      }
+
+      // Types have their result id first, constants and variables second
+      if (instruction.opcode >= OP_TYPE_BOOL &&
+          instruction.opcode <= OP_TYPE_POINTER && !operands.empty()) {
+        m_ids[operands[0]] = instruction;
+      } else if ((instruction.opcode == OP_CONSTANT ||
+                  instruction.opcode == OP_VARIABLE) &&
+                 operands.size() >= 2) {
+        m_ids[operands[1]] = instruction;
+      }
+    }
+  }
+
+  bool valid() const { return m_valid; }
+
+  const char *stage() const {
+    switch (m_executionModel) {
+    case 0:
+      return "VK_SHADER_STAGE_VERTEX_BIT";
+    case 1:
+      return "VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT";
+    case 2:
+      return "VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT";
+    case 3:
+      return "VK_SHADER_STAGE_GEOMETRY_BIT";
+    case 4:
+      return "VK_SHADER_STAGE_FRAGMENT_BIT";
+    case 5:
+      return "VK_SHADER_STAGE_COMPUTE_BIT";
+    default:
+      return nullptr;
+    }
+  }
+
+  bool vertexStage() const { return m_executionModel == 0; }
+
+  std::vector<Binding> bindings() const {
+    std::vector<Binding> bindings;
+
+    for (uint32_t variable : m_variables) {
+      uint32_t storage = m_ids.at(variable).operands[2];
+      if (storage != STORAGE_UNIFORM_CONSTANT && storage != STORAGE_UNIFORM &&
+          storage != STORAGE_STORAGE_BUFFER) {
+        continue;
+      }
+
+      Binding binding = {};
+      binding.set = decoration(variable, DECORATION_DESCRIPTOR_SET);
+      binding.binding = decoration(variable, DECORATION_BINDING);
+      binding.count = 1;
+      if (binding.set == NOT_DECORATED) {
+        binding.set = 0;
+      }
+      if (binding.binding == NOT_DECORATED) {
+        continue;
+      }
+
+      // Arrays of descriptors, runtime sized ones are sized by the caller
+      uint32_t type = pointee(variable);
+      if (opcode(type) == OP_TYPE_ARRAY) {
+        binding.count = constant(m_ids.at(type).operands[2]);
+        type = m_ids.at(type).operands[1];
+      } else if (opcode(type) == OP_TYPE_RUNTIME_ARRAY) {
+        binding.count = 0;
+        type = m_ids.at(type).operands[1];
+      }
+
+      binding.type = descriptorType(storage, type);
+      if (binding.type.empty()) {
+        continue;
+      }
+
+      bindings.push_back(binding);
+    }
+
+    std::sort(bindings.begin(), bindings.end(),
+              [](const Binding &a, const Binding &b) {
+                return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+    return bindings;
+  }
+
+  // Push constant blocks may start past 0, the range always starts at 0
+  uint32_t pushConstantSize() const {
+    for (uint32_t variable : m_variables) {
+      if (m_ids.at(variable).operands[2] == STORAGE_PUSH_CONSTANT) {
+        return size(pointee(variable));
+      }
+    }
+    return 0;
+  }
+
+  std::vector<Input> inputs() const {
+    std::vector<Input> inputs;
+    if (!vertexStage()) {
+      return inputs;
+    }
+
+    for (uint32_t variable : m_variables) {
+      if (m_ids.at(variable).operands[2] != STORAGE_INPUT ||
+          decoration(variable, DECORATION_BUILT_IN) != NOT_DECORATED) {
+        continue;
+      }
+
+      uint32_t location = decoration(variable, DECORATION_LOCATION);
+      if (location == NOT_DECORATED) {
+        continue;
+      }
+
+      inputs.push_back({location, format(pointee(variable))});
+    }
+
+    std::sort(inputs.begin(), inputs.end(),
+              [](const Input &a, const Input &b) {
+                return a.location < b.location;
+              });
+    return inputs;
+  }
+
+private:
+  uint32_t opcode(uint32_t id) const {
+    auto it = m_ids.find(id);
+    return it == m_ids.end() ? 0 : it->second.opcode;
+  }
+
+  uint32_t decoration(uint32_t id, uint32_t decoration) const {
+    auto it = m_decorations.find(id);
+    if (it == m_decorations.end()) {
+      return NOT_DECORATED;
+    }
+    auto value = it->second.find(decoration);
+    return value == it->second.end() ? NOT_DECORATED : value->second;
+  }
+
+  uint32_t memberDecoration(uint32_t id, uint32_t member,
+                            uint32_t decoration) const {
+    auto it = m_memberDecorations.find(id);
+    if (it == m_memberDecorations.end()) {
+      return NOT_DECORATED;
+    }
+    auto decorations = it->second.find(member);
+    if (decorations == it->second.end()) {
+      return NOT_DECORATED;
+    }
+    auto value = decorations->second.find(decoration);
+    return value == decorations->second.end() ? NOT_DECORATED : value->second;
+  }
+
+  uint32_t pointee(uint32_t variable) const {
+    return m_ids.at(m_ids.at(variable).operands[0]).operands[2];
+  }
+
+  uint32_t constant(uint32_t id) const {
+    return m_ids.at(id).operands.at(2);
+  }
+
+  std::string descriptorType(uint32_t storage, uint32_t type) const {
+    const std::vector<uint32_t> &operands = m_ids.at(type).operands;
+
+    switch (opcode(type)) {
+    case OP_TYPE_SAMPLED_IMAGE:
+      if (m_ids.at(operands[1]).operands[2] == DIM_BUFFER) {
+        return "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER";
+      }
+      return "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER";
+    case OP_TYPE_IMAGE:
+      if (operands[2] == DIM_BUFFER) {
+        return operands[6] == 2 ? "VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER"
+                                : "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER";
+      }
+      // Sampled is 2 for images only read and written without a sampler
+      return operands[6] == 2 ? "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE"
+                              : "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE";
+    case OP_TYPE_SAMPLER:
+      return "VK_DESCRIPTOR_TYPE_SAMPLER";
+    case OP_TYPE_STRUCT:
+      // SPIR-V 1.0 marks storage buffers with BufferBlock in Uniform storage
+      if (storage == STORAGE_STORAGE_BUFFER ||
+          decoration(type, DECORATION_BUFFER_BLOCK) != NOT_DECORATED) {
+        return "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER";
+      }
+      return "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER";
+    default:
+      return "";
+    }
+  }
+
+  // Size of a type laid out with its explicit offsets and strides
+  uint32_t size(uint32_t type) const {
+    const std::vector<uint32_t> &operands = m_ids.at(type).operands;
+
+    switch (opcode(type)) {
+    case OP_TYPE_BOOL:
+      return 4;
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+      return operands[1] / 8;
+    case OP_TYPE_VECTOR:
+      return size(operands[1]) * operands[2];
+    case OP_TYPE_MATRIX:
+      return size(operands[1]) * operands[2];
+    case OP_TYPE_ARRAY: {
+      uint32_t stride = decoration(type, DECORATION_ARRAY_STRIDE);
+      if (stride == NOT_DECORATED) {
+        stride = size(operands[1]);
+      }
+      return stride * constant(operands[2]);
+    }
+    case OP_TYPE_STRUCT: {
+      uint32_t end = 0;
+      for (uint32_t member = 0; member + 1 < operands.size(); ++member) {
+        uint32_t offset = memberDecoration(type, member, DECORATION_OFFSET);
+        uint32_t stride =
+            memberDecoration(type, member, DECORATION_MATRIX_STRIDE);
+        uint32_t memberType = operands[member + 1];
+        uint32_t memberSize = size(memberType);
+        if (stride != NOT_DECORATED && opcode(memberType) == OP_TYPE_MATRIX) {
+          memberSize = stride * m_ids.at(memberType).operands[2];
+        }
+        end = std::max(end,
+                       (offset == NOT_DECORATED ? end : offset) + memberSize);
+      }
+      return end;
+    }
+    default:
+      return 0;
+    }
+  }
+
+  std::string format(uint32_t type) const {
+    uint32_t components = 1;
+    if (opcode(type) == OP_TYPE_VECTOR) {
+      components = m_ids.at(type).operands[2];
+      type = m_ids.at(type).operands[1];
+    }
+
+    const std::vector<uint32_t> &operands = m_ids.at(type).operands;
+    std::string suffix;
+    if (opcode(type) == OP_TYPE_FLOAT) {
+      suffix = "SFLOAT";
+    } else if (opcode(type) == OP_TYPE_INT) {
+      suffix = operands[2] ? "SINT" : "UINT";
+    } else {
+      return "";
+    }
+
+    std::string bits = std::to_string(operands[1]);
+    const char *channels[] = {"R", "G", "B", "A"};
+    std::string format = "VK_FORMAT_";
+    for (uint32_t i = 0; i < components && i < 4; ++i) {
+      format += channels[i] + bits;
+    }
+    return format + "_" + suffix;
+  }
+
+  bool m_valid = true;
+  uint32_t m_executionModel = UINT32_MAX;
+  std::map<uint32_t, Instruction> m_ids;
+  std::vector<uint32_t> m_variables;
+  std::map<uint32_t, std::map<uint32_t, uint32_t>> m_decorations;
+  std::map<uint32_t, std::map<uint32_t, std::map<uint32_t, uint32_t>>>
+      m_memberDecorations;
+};
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    printf("Usage: spirv_reflect <input.spv> <output.h> <symbol>\n");
+    return EXIT_FAILURE;
+  }
+
+  const char *inputPath = argv[1];
+  const char *outputPath = argv[2];
+  std::string symbol = argv[3];
+
+  FILE *input = fopen(inputPath, "rb");
+  if (!input) {
+    fail("Can't open the module", inputPath);
+  }
+
+  std::vector<uint32_t> words;
+  uint32_t word;
+  while (fread(&word, sizeof(word), 1, input) == 1) {
+    words.push_back(word);
+  }
+  fclose(input);
+
+  if (words.size() < 5 || words[0] != SPIRV_MAGIC) {
+    fail("Not a SPIR-V module", inputPath);
+  }
+
+  Module module(words);
+  if (!module.valid() || !module.stage()) {
+    fail("No entry point or a truncated instruction", inputPath);
+  }
+
+  std::vector<Binding> bindings = module.bindings();
+  std::vector<Input> inputs = module.inputs();
+  for (const Input &input : inputs) {
+    if (input.format.empty()) {
+      fail("Vertex input of a type vertex buffers can't hold", inputPath);
+    }
+  }
+
+  FILE *output = fopen(outputPath, "w");
+  if (!output) {
+    fail("Can't write the header", outputPath);
+  }
+
+  fprintf(output, "// Generated from %s, do not edit\n", inputPath);
+  fprintf(output, "#include \"shaders.h\"\n\n");
+
+  // Empty arrays aren't allowed, absent tables are null pointers
+  std::string bindingTable = "nullptr";
+  if (!bindings.empty()) {
+    bindingTable = symbol + "_bindings";
+    fprintf(output, "constexpr ShaderBinding %s[] = {\n", bindingTable.c_str());
+    for (const Binding &binding : bindings) {
+      fprintf(output, "  {%u, %u, %s, %u},\n", binding.set, binding.binding,
+              binding.type.c_str(), binding.count);
+    }
+    fprintf(output, "};\n\n");
+  }
+
+  std::string inputTable = "nullptr";
+  if (!inputs.empty()) {
+    inputTable = symbol + "_inputs";
+    fprintf(output, "constexpr ShaderInput %s[] = {\n", inputTable.c_str());
+    for (const Input &input : inputs) {
+      fprintf(output, "  {%u, %s},\n", input.location, input.format.c_str());
+    }
+    fprintf(output, "};\n\n");
+  }
+
+  fprintf(output, "constexpr ShaderReflection %s_reflection = {\n",
+          symbol.c_str());
+  fprintf(output, "  %s,\n", module.stage());
+  fprintf(output, "  %s, %zu,\n", bindingTable.c_str(), bindings.size());
+  fprintf(output, "  %s, %zu,\n", inputTable.c_str(), inputs.size());
+  fprintf(output, "  %u,\n", module.pushConstantSize());
+  fprintf(output, "};\n");
+
+  fclose(output);
+  return EXIT_SUCCESS;
+}
@@ -1,13 +1,22 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Material features, set per pipeline or read from the object by the generic one
+layout( constant_id = 1 ) const bool TEXTURE          = true;
+layout( constant_id = 2 ) const bool RUNTIME_FEATURES = false;
+
 layout( binding = 1 ) uniform sampler2D texSampler;
 
 layout( location = 0 ) in vec3 fragColor;
 layout( location = 1 ) in vec2 fragTexCoord;
+layout( location = 3 ) flat in uint fragFeatures;
 
 layout( location = 0 ) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor * texture(texSampler, fragTexCoord).rgb, 1.0);
+    vec3 color = fragColor;
+    if (RUNTIME_FEATURES ? ( fragFeatures & 2u ) != 0u : TEXTURE) {
+        color *= texture(texSampler, fragTexCoord).rgb;
+    }
+    outColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -1,21 +1,81 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout( binding = 0 ) uniform UniformBufferObject {
+// Material features, set per pipeline. The generic pipeline reads the
+// object's features instead, its draws can mix materials.
+layout( constant_id = 0 ) const bool VERTEX_COLOR     = true;
+layout( constant_id = 1 ) const bool TEXTURE          = true;
+layout( constant_id = 2 ) const bool RUNTIME_FEATURES = false;
+
+struct Object {
     mat4 model;
+    uint batch;
+    uint textureIndex;
+    uint color;
+    uint features;
+};
+
+// Written once per frame, objects carry their own model matrix
+layout( binding = 0 ) uniform UniformBufferObject {
     mat4 view;
     mat4 proj;
 } ubo;
 
+// One entry per instance, draws pass their first one as the first instance
+layout( std430, binding = 2 ) readonly buffer Objects {
+    Object objects[];
+};
+
+// Draws of a single object may push it instead, nothing is written to the
+// object buffer for them
+layout( push_constant ) uniform Draw {
+    uint   pushed;
+    Object object;
+} draw;
+
+#ifdef VERTEX_PULLING
+// The geometry pool's streams, indexed with gl_VertexIndex which already holds
+// the draw's vertex offset. Read as floats, the packed vertices have no
+// std430 vector alignment.
+layout( std430, binding = 3 ) readonly buffer Positions {
+    float positions[];
+};
+
+layout( std430, binding = 4 ) readonly buffer Attributes {
+    float attributes[];
+};
+#else
 layout( location = 0 ) in vec3 inPosition;
 layout( location = 1 ) in vec3 inColor;
 layout( location = 2 ) in vec2 inTexCoord;
+#endif
 
 layout( location = 0 ) out vec3 fragColor;
 layout( location = 1 ) out vec2 fragTexCoord;
+layout( location = 2 ) flat out uint fragTextureIndex;
+layout( location = 3 ) flat out uint fragFeatures;
+
+// Matches depth.vert's for the equal depth test after the pre-pass
+invariant gl_Position;
 
 void main() {
-    gl_Position  = ubo.proj * ubo.view * ubo.model * vec4( inPosition, 1.0 );
-    fragColor    = inColor;
-    fragTexCoord = inTexCoord;
+#ifdef VERTEX_PULLING
+    // VertexPosition is 3 floats, VertexAttributes 5
+    uint p          = uint( gl_VertexIndex ) * 3;
+    uint a          = uint( gl_VertexIndex ) * 5;
+    vec3 inPosition = vec3( positions[p], positions[p + 1], positions[p + 2] );
+    vec3 inColor    = vec3( attributes[a], attributes[a + 1], attributes[a + 2] );
+    vec2 inTexCoord = vec2( attributes[a + 3], attributes[a + 4] );
+#endif
+
+    Object object = draw.pushed != 0u ? draw.object : objects[gl_InstanceIndex];
+    uint features = RUNTIME_FEATURES ? object.features
+                                     : ( VERTEX_COLOR ? 1u : 0u ) | ( TEXTURE ? 2u : 0u );
+    vec3 color    = unpackUnorm4x8( object.color ).rgb;
+
+    gl_Position      = ubo.proj * ubo.view * object.model * vec4( inPosition, 1.0 );
+    fragColor        = ( features & 1u ) != 0u ? inColor * color : color;
+    fragTexCoord     = ( features & 2u ) != 0u ? inTexCoord : vec2( 0.0 );
+    fragTextureIndex = object.textureIndex;
+    fragFeatures     = features;
 }
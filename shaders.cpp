@@ -0,0 +1,165 @@
+#include "shaders.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Generated from ressources/ by the SHADERS list in CMakeLists.txt
+#include "shaders/bindless.frag.h"
+#include "shaders/bindless.frag.reflect.h"
+#include "shaders/cull.comp.h"
+#include "shaders/cull.comp.reflect.h"
+#include "shaders/depth.pull.vert.h"
+#include "shaders/depth.pull.vert.reflect.h"
+#include "shaders/depth.vert.h"
+#include "shaders/depth.vert.reflect.h"
+#include "shaders/depthpyramid.comp.h"
+#include "shaders/depthpyramid.comp.reflect.h"
+#include "shaders/triangle.frag.h"
+#include "shaders/triangle.frag.reflect.h"
+#include "shaders/triangle.pull.vert.h"
+#include "shaders/triangle.pull.vert.reflect.h"
+#include "shaders/triangle.vert.h"
+#include "shaders/triangle.vert.reflect.h"
+
+// The scene pipelines share one layout, the depth pre-pass included
+static_assert(Shaders::compatible(triangle_vert_reflection,
+                                  triangle_frag_reflection),
+              "triangle.vert and triangle.frag disagree on a binding");
+static_assert(Shaders::compatible(triangle_vert_reflection,
+                                  bindless_frag_reflection),
+              "triangle.vert and bindless.frag disagree on a binding");
+static_assert(Shaders::compatible(depth_vert_reflection,
+                                  triangle_vert_reflection),
+              "depth.vert and triangle.vert disagree on a binding");
+static_assert(Shaders::compatible(depth_vert_reflection,
+                                  triangle_frag_reflection),
+              "depth.vert and triangle.frag disagree on a binding");
+static_assert(Shaders::compatible(depth_vert_reflection,
+                                  bindless_frag_reflection),
+              "depth.vert and bindless.frag disagree on a binding");
+
+// Pulling variants add the geometry pool's bindings to the same layout
+static_assert(Shaders::compatible(triangle_pull_vert_reflection,
+                                  triangle_frag_reflection),
+              "triangle.pull.vert and triangle.frag disagree on a binding");
+static_assert(Shaders::compatible(triangle_pull_vert_reflection,
+                                  bindless_frag_reflection),
+              "triangle.pull.vert and bindless.frag disagree on a binding");
+static_assert(Shaders::compatible(depth_pull_vert_reflection,
+                                  triangle_pull_vert_reflection),
+              "depth.pull.vert and triangle.pull.vert disagree on a binding");
+
+static const ShaderBinary SHADERS[] = {
+    {"bindless.frag", bindless_frag_spv, sizeof(bindless_frag_spv),
+     bindless_frag_reflection},
+    {"cull.comp", cull_comp_spv, sizeof(cull_comp_spv),
+     cull_comp_reflection},
+    {"depth.pull.vert", depth_pull_vert_spv, sizeof(depth_pull_vert_spv),
+     depth_pull_vert_reflection},
+    {"depth.vert", depth_vert_spv, sizeof(depth_vert_spv),
+     depth_vert_reflection},
+    {"depthpyramid.comp", depthpyramid_comp_spv, sizeof(depthpyramid_comp_spv),
+     depthpyramid_comp_reflection},
+    {"triangle.frag", triangle_frag_spv, sizeof(triangle_frag_spv),
+     triangle_frag_reflection},
+    {"triangle.pull.vert", triangle_pull_vert_spv,
+     sizeof(triangle_pull_vert_spv), triangle_pull_vert_reflection},
+    {"triangle.vert", triangle_vert_spv, sizeof(triangle_vert_spv),
+     triangle_vert_reflection},
+};
+
+const ShaderBinary &Shaders::get(const char *name) {
+  for (const ShaderBinary &shader : SHADERS) {
+    if (strcmp(shader.name, name) == 0) {
+      return shader;
+    }
+  }
+
+  printf("ERROR: Shader %s is not embedded\n", name);
+  exit(EXIT_FAILURE);
+}
+
+std::vector<VkDescriptorSetLayoutBinding>
+Shaders::setBindings(const std::vector<const char *> &shaders, uint32_t set,
+                     uint32_t runtimeArraySize) {
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+  for (const char *name : shaders) {
+    const ShaderReflection &reflection = get(name).reflection;
+
+    for (uint32_t i = 0; i < reflection.bindingCount; ++i) {
+      const ShaderBinding &binding = reflection.bindings[i];
+      if (binding.set != set) {
+        continue;
+      }
+
+      auto existing =
+          std::find_if(bindings.begin(), bindings.end(),
+                       [&](const VkDescriptorSetLayoutBinding &layout) {
+                         return layout.binding == binding.binding;
+                       });
+      if (existing != bindings.end()) {
+        existing->stageFlags |= reflection.stage;
+        continue;
+      }
+
+      VkDescriptorSetLayoutBinding layout = {};
+      layout.binding = binding.binding;
+      layout.descriptorType = binding.type;
+      layout.descriptorCount =
+          binding.count == 0 ? runtimeArraySize : binding.count;
+      layout.stageFlags = reflection.stage;
+      layout.pImmutableSamplers = nullptr;
+      bindings.push_back(layout);
+    }
+  }
+
+  std::sort(bindings.begin(), bindings.end(),
+            [](const VkDescriptorSetLayoutBinding &a,
+               const VkDescriptorSetLayoutBinding &b) {
+              return a.binding < b.binding;
+            });
+  return bindings;
+}
+
+std::vector<VkDescriptorPoolSize>
+Shaders::poolSizes(const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+                   uint32_t setCount) {
+  std::vector<VkDescriptorPoolSize> sizes;
+
+  for (const VkDescriptorSetLayoutBinding &binding : bindings) {
+    auto existing = std::find_if(sizes.begin(), sizes.end(),
+                                 [&](const VkDescriptorPoolSize &size) {
+                                   return size.type == binding.descriptorType;
+                                 });
+    if (existing == sizes.end()) {
+      sizes.push_back({binding.descriptorType, 0});
+      existing = sizes.end() - 1;
+    }
+    existing->descriptorCount += binding.descriptorCount * setCount;
+  }
+
+  return sizes;
+}
+
+std::vector<VkPushConstantRange>
+Shaders::pushConstantRanges(const std::vector<const char *> &shaders) {
+  VkPushConstantRange range = {};
+
+  for (const char *name : shaders) {
+    const ShaderReflection &reflection = get(name).reflection;
+    if (reflection.pushConstantSize == 0) {
+      continue;
+    }
+
+    range.stageFlags |= reflection.stage;
+    range.size = std::max(range.size, reflection.pushConstantSize);
+  }
+
+  if (range.size == 0) {
+    return {};
+  }
+  return {range};
+}
@@ -0,0 +1,78 @@
+#ifndef VULKAN_SHADERS_H
+#define VULKAN_SHADERS_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Reflection of a shader's interface, written at build time by
+// ressources/spirv_reflect.cpp next to the embedded SPIR-V
+struct ShaderBinding {
+  uint32_t         set;
+  uint32_t         binding;
+  VkDescriptorType type;
+  // 0 for runtime sized arrays, their size is picked by the pipeline
+  uint32_t         count;
+};
+
+struct ShaderInput {
+  uint32_t location;
+  VkFormat format;
+};
+
+struct ShaderReflection {
+  VkShaderStageFlagBits stage;
+  // Ordered by set then binding
+  const ShaderBinding*  bindings;
+  uint32_t              bindingCount;
+  // Vertex shaders only, ordered by location
+  const ShaderInput*    inputs;
+  uint32_t              inputCount;
+  // The range starts at 0, 0 without a push constant block
+  uint32_t              pushConstantSize;
+};
+
+// SPIR-V compiled, optimized and stripped of debug info by the build, which
+// writes every shader to a header included by shaders.cpp
+struct ShaderBinary {
+  const char*      name;
+  const uint32_t*  code;
+  // In bytes, as VkShaderModuleCreateInfo wants it
+  size_t           size;
+  ShaderReflection reflection;
+};
+
+namespace Shaders {
+  // Looked up by source file name, "triangle.vert" for example. Exits when the
+  // shader isn't part of the build.
+  const ShaderBinary& get( const char* name );
+
+  // Bindings of one set over all the shaders using it, the stages reading a
+  // binding are merged. Runtime sized arrays get runtimeArraySize descriptors.
+  std::vector< VkDescriptorSetLayoutBinding > setBindings( const std::vector< const char* >& shaders, uint32_t set, uint32_t runtimeArraySize = 0 );
+
+  // Enough descriptors of every type for setCount sets of the layout
+  std::vector< VkDescriptorPoolSize > poolSizes( const std::vector< VkDescriptorSetLayoutBinding >& bindings, uint32_t setCount );
+
+  // One range for all the stages, empty when none has push constants
+  std::vector< VkPushConstantRange > pushConstantRanges( const std::vector< const char* >& shaders );
+
+  // Shaders of one pipeline layout must agree on the bindings they share,
+  // shaders.cpp checks it at build time
+  constexpr bool compatible( const ShaderReflection& a, const ShaderReflection& b ) {
+    for( uint32_t i = 0; i < a.bindingCount; ++i ) {
+      for( uint32_t j = 0; j < b.bindingCount; ++j ) {
+        const ShaderBinding& x = a.bindings[i];
+        const ShaderBinding& y = b.bindings[j];
+        if( x.set == y.set && x.binding == y.binding && ( x.type != y.type || x.count != y.count ) ) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+#endif //VULKAN_SHADERS_H
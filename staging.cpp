@@ -0,0 +1,461 @@
+#include "staging.h"
+
+#include <algorithm>
+#include <cstring>
+
+void StagingRing::create(VkDevice device, VkPhysicalDevice physicalDevice,
+                         VkDeviceSize capacity) {
+  m_device = device;
+  m_capacity = capacity;
+  m_head = 0;
+  m_tail = 0;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = capacity;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_buffer),
+           "Creating staging ring");
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(m_device, m_buffer, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex = Utils::findMemoryType(
+      physicalDevice, memRequirements.memoryTypeBits,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  VK_CHECK(vkAllocateMemory(m_device, &allocInfo, nullptr, &m_memory),
+           "Allocating staging ring memory");
+  VK_CHECK(vkBindBufferMemory(m_device, m_buffer, m_memory, 0),
+           "Binding staging ring memory");
+
+  // Mapped once for the whole lifetime of the ring
+  void *data;
+  VK_CHECK(vkMapMemory(m_device, m_memory, 0, VK_WHOLE_SIZE, 0, &data),
+           "Mapping staging ring");
+  m_mapped = static_cast<uint8_t *>(data);
+}
+
+void StagingRing::destroy() {
+  vkUnmapMemory(m_device, m_memory);
+  vkDestroyBuffer(m_device, m_buffer, nullptr);
+  vkFreeMemory(m_device, m_memory, nullptr);
+
+  m_mapped = nullptr;
+  m_buffer = VK_NULL_HANDLE;
+  m_memory = VK_NULL_HANDLE;
+}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment,
+                           StagingAllocation &allocation) {
+  // Nothing in flight, start over from the beginning of the buffer
+  if (used() == 0) {
+    m_head = 0;
+    m_tail = 0;
+  }
+
+  VkDeviceSize position = m_head % m_capacity;
+  VkDeviceSize start = (position + alignment - 1) / alignment * alignment;
+
+  // Never split an allocation across the end of the buffer, skip the tail
+  if (start + size > m_capacity) {
+    start = 0;
+  }
+
+  VkDeviceSize consumed = start >= position
+                              ? start - position + size
+                              : m_capacity - position + start + size;
+
+  if (used() + consumed > m_capacity) {
+    return false;
+  }
+
+  m_head += consumed;
+
+  allocation.buffer = m_buffer;
+  allocation.offset = start;
+  allocation.size = size;
+  allocation.data = m_mapped + start;
+
+  return true;
+}
+
+void StagingRing::release(VkDeviceSize mark) {
+  // A mark from before a reset lies past the head, never wrap used() around
+  m_tail = std::min(std::max(m_tail, mark), m_head);
+}
+
+static bool lowerPriority(const UploadRequest &a, uint64_t aSequence,
+                          const UploadRequest &b, uint64_t bSequence) {
+  if (a.priority != b.priority) {
+    return a.priority < b.priority;
+  }
+
+  return aSequence > bSequence;
+}
+
+void UploadScheduler::create(VkDevice device, VkPhysicalDevice physicalDevice,
+                             VkQueue queue, uint32_t queueFamily,
+                             VkDeviceSize ringSize, VkDeviceSize frameBudget) {
+  m_device = device;
+  m_queue = queue;
+  m_frameBudget = frameBudget;
+
+  m_ring.create(device, physicalDevice, ringSize);
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = queueFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  VK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool),
+           "Creating upload command pool");
+}
+
+void UploadScheduler::destroy() {
+  reclaim(true);
+
+  for (Batch &batch : m_freeBatches) {
+    vkDestroyFence(m_device, batch.fence, nullptr);
+  }
+  m_freeBatches.clear();
+  m_pending.clear();
+
+  vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+  m_ring.destroy();
+}
+
+void UploadScheduler::enqueue(UploadRequest request) {
+  if (request.size == 0 && !request.record) {
+    if (request.completed) {
+      request.completed();
+    }
+    return;
+  }
+
+  if (request.granularity > m_ring.capacity() / 2) {
+    printf("ERROR: Upload granularity larger than the staging ring\n");
+    exit(EXIT_FAILURE);
+  }
+
+  m_pending.push_back({std::move(request), 0, m_sequence++});
+  std::push_heap(m_pending.begin(), m_pending.end(),
+                 [](const Pending &a, const Pending &b) {
+                   return lowerPriority(a.request, a.sequence, b.request,
+                                        b.sequence);
+                 });
+}
+
+void UploadScheduler::uploadBuffer(const void *data, VkDeviceSize size,
+                                   VkBuffer dst, VkDeviceSize dstOffset,
+                                   uint32_t priority,
+                                   std::function<void()> completed) {
+  UploadRequest request;
+  request.size = size;
+  request.priority = priority;
+  request.completed = std::move(completed);
+  request.write = [data](void *staging, VkDeviceSize offset,
+                         VkDeviceSize size) {
+    memcpy(staging, static_cast<const uint8_t *>(data) + offset, size);
+  };
+  request.record = [dst, dstOffset](VkCommandBuffer cmd, VkBuffer staging,
+                                    VkDeviceSize stagingOffset,
+                                    VkDeviceSize offset, VkDeviceSize size) {
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = stagingOffset;
+    copyRegion.dstOffset = dstOffset + offset;
+    copyRegion.size = size;
+
+    vkCmdCopyBuffer(cmd, staging, dst, 1, &copyRegion);
+  };
+
+  enqueue(std::move(request));
+}
+
+void UploadScheduler::uploadImage(const void *pixels, VkImage image,
+                                  uint32_t width, uint32_t height,
+                                  uint32_t texelSize, uint32_t mipLevel,
+                                  uint32_t priority,
+                                  std::function<void()> completed) {
+  VkDeviceSize rowPitch = (VkDeviceSize)width * texelSize;
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = mipLevel;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+
+  UploadRequest request;
+  request.size = rowPitch * height;
+  request.granularity = rowPitch;
+  request.alignment = std::max<VkDeviceSize>(texelSize, 16);
+  request.priority = priority;
+  request.completed = std::move(completed);
+  request.write = [pixels](void *staging, VkDeviceSize offset,
+                           VkDeviceSize size) {
+    memcpy(staging, static_cast<const uint8_t *>(pixels) + offset, size);
+  };
+  request.record = [image, width, rowPitch,
+                    mipLevel](VkCommandBuffer cmd, VkBuffer staging,
+                              VkDeviceSize stagingOffset, VkDeviceSize offset,
+                              VkDeviceSize size) {
+    VkBufferImageCopy region = {};
+    region.bufferOffset = stagingOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageOffset = {0, (int32_t)(offset / rowPitch), 0};
+    region.imageExtent = {width, (uint32_t)(size / rowPitch), 1};
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mipLevel;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    vkCmdCopyBufferToImage(cmd, staging, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  };
+  request.prologue = [barrier](VkCommandBuffer cmd) {
+    VkImageMemoryBarrier toTransfer = barrier;
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransfer.srcAccessMask = 0;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &toTransfer);
+  };
+  request.epilogue = [barrier](VkCommandBuffer cmd) {
+    VkImageMemoryBarrier toShader = barrier;
+    toShader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    toShader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &toShader);
+  };
+
+  enqueue(std::move(request));
+}
+
+void UploadScheduler::update() {
+  m_bytesThisFrame = 0;
+  reclaim(false);
+  submit(m_frameBudget);
+}
+
+void UploadScheduler::flush() {
+  while (!m_pending.empty()) {
+    submit(UINT64_MAX);
+    reclaim(true);
+  }
+  reclaim(true);
+}
+
+UploadStats UploadScheduler::stats() const {
+  UploadStats stats = {};
+  stats.bytesThisFrame = m_bytesThisFrame;
+  stats.requestsPending = (uint32_t)m_pending.size();
+  stats.batchesInFlight = (uint32_t)m_inFlight.size();
+
+  for (const Pending &pending : m_pending) {
+    stats.bytesPending += pending.request.size - pending.offset;
+  }
+
+  return stats;
+}
+
+UploadScheduler::Batch UploadScheduler::acquireBatch() {
+  if (!m_freeBatches.empty()) {
+    Batch batch = m_freeBatches.back();
+    m_freeBatches.pop_back();
+    return batch;
+  }
+
+  Batch batch = {};
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = m_commandPool;
+  allocInfo.commandBufferCount = 1;
+
+  VK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, &batch.commandBuffer),
+           "Allocating upload command buffer");
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VK_CHECK(vkCreateFence(m_device, &fenceInfo, nullptr, &batch.fence),
+           "Creating upload fence");
+
+  return batch;
+}
+
+void UploadScheduler::submit(VkDeviceSize budget) {
+  auto heapOrder = [](const Pending &a, const Pending &b) {
+    return lowerPriority(a.request, a.sequence, b.request, b.sequence);
+  };
+
+  Batch batch = {};
+  bool recording = false;
+  VkDeviceSize recorded = 0;
+  VkDeviceSize maxChunk = m_ring.capacity() / 2;
+
+  auto beginBatch = [this, &batch, &recording]() {
+    if (recording) {
+      return;
+    }
+
+    batch = acquireBatch();
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(batch.commandBuffer, &beginInfo),
+             "Beginning upload command buffer");
+    recording = true;
+  };
+
+  while (!m_pending.empty() && recorded < budget) {
+    std::pop_heap(m_pending.begin(), m_pending.end(), heapOrder);
+    Pending &pending = m_pending.back();
+    UploadRequest &request = pending.request;
+
+    if (request.size == 0) {
+      beginBatch();
+
+      if (request.prologue) {
+        request.prologue(batch.commandBuffer);
+      }
+      request.record(batch.commandBuffer, VK_NULL_HANDLE, 0, 0, 0);
+      if (request.epilogue) {
+        request.epilogue(batch.commandBuffer);
+      }
+      if (request.completed) {
+        batch.completions.push_back(std::move(request.completed));
+      }
+      m_pending.pop_back();
+      continue;
+    }
+
+    VkDeviceSize remaining = request.size - pending.offset;
+    VkDeviceSize chunk = std::min(std::min(remaining, budget - recorded), maxChunk);
+
+    if (request.granularity != 0 && chunk < remaining) {
+      chunk -= chunk % request.granularity;
+
+      // Always make progress on the first chunk of a frame, even over budget
+      if (chunk == 0 && recorded == 0) {
+        chunk = std::min(request.granularity, remaining);
+      }
+    }
+
+    StagingAllocation allocation;
+    if (chunk == 0 ||
+        !m_ring.allocate(chunk, request.alignment, allocation)) {
+      std::push_heap(m_pending.begin(), m_pending.end(), heapOrder);
+      break;
+    }
+
+    beginBatch();
+
+    if (pending.offset == 0 && request.prologue) {
+      request.prologue(batch.commandBuffer);
+    }
+
+    request.write(allocation.data, pending.offset, chunk);
+    request.record(batch.commandBuffer, allocation.buffer, allocation.offset,
+                   pending.offset, chunk);
+
+    pending.offset += chunk;
+    recorded += chunk;
+
+    if (pending.offset == request.size) {
+      if (request.epilogue) {
+        request.epilogue(batch.commandBuffer);
+      }
+      if (request.completed) {
+        batch.completions.push_back(std::move(request.completed));
+      }
+      m_pending.pop_back();
+    } else {
+      std::push_heap(m_pending.begin(), m_pending.end(), heapOrder);
+    }
+  }
+
+  if (!recording) {
+    return;
+  }
+
+  // Make every transfer of the batch visible to whatever is submitted next
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  VK_CHECK(vkEndCommandBuffer(batch.commandBuffer),
+           "Ending upload command buffer");
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+  VK_CHECK(vkQueueSubmit(m_queue, 1, &submitInfo, batch.fence),
+           "Submitting uploads");
+
+  // Copy-only batches hold no ring space, their mark may outlive a reset
+  batch.staged = recorded != 0;
+  batch.ringMark = batch.staged ? m_ring.mark() : 0;
+  m_inFlight.push_back(std::move(batch));
+  m_bytesThisFrame += recorded;
+}
+
+void UploadScheduler::reclaim(bool wait) {
+  while (!m_inFlight.empty()) {
+    VkFence fence = m_inFlight.front().fence;
+
+    if (wait) {
+      VK_CHECK(vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX),
+               "Waiting upload fence");
+    } else if (vkGetFenceStatus(m_device, fence) != VK_SUCCESS) {
+      break;
+    }
+
+    Batch batch = std::move(m_inFlight.front());
+    m_inFlight.erase(m_inFlight.begin());
+    if (batch.staged) {
+      m_ring.release(batch.ringMark);
+    }
+    VK_CHECK(vkResetFences(m_device, 1, &batch.fence), "Reseting upload fence");
+
+    std::vector<std::function<void()>> completions;
+    completions.swap(batch.completions);
+    m_freeBatches.push_back(std::move(batch));
+
+    // Callbacks may enqueue follow-up uploads
+    for (std::function<void()> &completed : completions) {
+      completed();
+    }
+  }
+}
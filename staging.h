@@ -0,0 +1,120 @@
+#ifndef VULKAN_STAGING_H
+#define VULKAN_STAGING_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include "utils.h"
+
+struct StagingAllocation {
+  VkBuffer     buffer;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  void*        data;
+};
+
+// One persistently mapped host visible buffer used as a FIFO ring. Offsets are
+// tracked as absolute byte counters, the position in the buffer is the counter
+// modulo the capacity. Space is handed back in submission order with release().
+class StagingRing {
+public:
+  void create( VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize capacity );
+  void destroy();
+
+  bool allocate( VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& allocation );
+  void release( VkDeviceSize mark );
+
+  VkDeviceSize mark() const { return m_head; }
+  VkDeviceSize capacity() const { return m_capacity; }
+  VkDeviceSize used() const { return m_head - m_tail; }
+
+private:
+  VkDevice       m_device   = VK_NULL_HANDLE;
+  VkBuffer       m_buffer   = VK_NULL_HANDLE;
+  VkDeviceMemory m_memory   = VK_NULL_HANDLE;
+  uint8_t*       m_mapped   = nullptr;
+  VkDeviceSize   m_capacity = 0;
+  VkDeviceSize   m_head     = 0;
+  VkDeviceSize   m_tail     = 0;
+};
+
+struct UploadRequest {
+  VkDeviceSize size        = 0;
+  // Chunks are cut on multiples of this ( eg: the row pitch of an image ), 0 allows any split
+  VkDeviceSize granularity = 0;
+  VkDeviceSize alignment   = 16;
+  // Higher priorities are uploaded first, equal priorities keep submission order
+  uint32_t     priority    = 0;
+
+  std::function< void( void* dst, VkDeviceSize offset, VkDeviceSize size ) > write;
+  // A request of size 0 records once without staging data ( eg: image to image copies )
+  std::function< void( VkCommandBuffer cmd, VkBuffer staging, VkDeviceSize stagingOffset, VkDeviceSize offset, VkDeviceSize size ) > record;
+  std::function< void( VkCommandBuffer cmd ) > prologue;
+  std::function< void( VkCommandBuffer cmd ) > epilogue;
+  // Called on the thread running update() once the last chunk's fence signaled
+  std::function< void() > completed;
+};
+
+struct UploadStats {
+  VkDeviceSize bytesThisFrame;
+  VkDeviceSize bytesPending;
+  uint32_t     requestsPending;
+  uint32_t     batchesInFlight;
+};
+
+// Streams UploadRequests through a StagingRing. update() is meant to be called
+// once per frame and never records more than the frame budget, large requests
+// are split into chunks over several frames.
+class UploadScheduler {
+public:
+  void create( VkDevice device, VkPhysicalDevice physicalDevice, VkQueue queue, uint32_t queueFamily, VkDeviceSize ringSize, VkDeviceSize frameBudget );
+  void destroy();
+
+  void enqueue( UploadRequest request );
+  // data must stay valid until completed is called
+  void uploadBuffer( const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset, uint32_t priority, std::function< void() > completed = nullptr );
+  void uploadImage( const void* pixels, VkImage image, uint32_t width, uint32_t height, uint32_t texelSize, uint32_t mipLevel, uint32_t priority, std::function< void() > completed = nullptr );
+
+  void update();
+  void flush();
+
+  void setFrameBudget( VkDeviceSize budget ) { m_frameBudget = budget; }
+  UploadStats stats() const;
+
+private:
+  struct Pending {
+    UploadRequest request;
+    VkDeviceSize  offset;
+    uint64_t      sequence;
+  };
+
+  struct Batch {
+    VkCommandBuffer                       commandBuffer;
+    VkFence                               fence;
+    VkDeviceSize                          ringMark;
+    bool                                  staged;
+    std::vector< std::function< void() > > completions;
+  };
+
+  void  submit( VkDeviceSize budget );
+  void  reclaim( bool wait );
+  Batch acquireBatch();
+
+  VkDevice      m_device = VK_NULL_HANDLE;
+  VkQueue       m_queue  = VK_NULL_HANDLE;
+  VkCommandPool m_commandPool = VK_NULL_HANDLE;
+  StagingRing   m_ring;
+
+  std::vector< Pending > m_pending;
+  std::vector< Batch >   m_inFlight;
+  std::vector< Batch >   m_freeBatches;
+
+  VkDeviceSize m_frameBudget    = 0;
+  VkDeviceSize m_bytesThisFrame = 0;
+  uint64_t     m_sequence       = 0;
+};
+
+#endif //VULKAN_STAGING_H
@@ -0,0 +1,211 @@
+#include "streaming.h"
+
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "submodules/tiny_obj_loader/tiny_obj_loader.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "submodules/stb-lib/stb_image.h"
+
+void AssetStreamer::start(uint32_t workerCount) {
+  m_stopping = false;
+
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    m_workers.emplace_back(&AssetStreamer::work, this);
+  }
+}
+
+void AssetStreamer::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_jobMutex);
+    m_stopping = true;
+    m_jobs.clear();
+  }
+  m_jobSignal.notify_all();
+
+  for (std::thread &worker : m_workers) {
+    worker.join();
+  }
+
+  m_workers.clear();
+  m_loaded.clear();
+}
+
+void AssetStreamer::request(AssetType type, uint32_t handle,
+                            std::string path) {
+  {
+    std::lock_guard<std::mutex> lock(m_jobMutex);
+    m_jobs.push_back({type, handle, std::move(path)});
+  }
+  m_jobSignal.notify_one();
+}
+
+bool AssetStreamer::poll(LoadedAsset &asset) {
+  std::lock_guard<std::mutex> lock(m_loadedMutex);
+
+  if (m_loaded.empty()) {
+    return false;
+  }
+
+  asset = std::move(m_loaded.front());
+  m_loaded.pop_front();
+
+  return true;
+}
+
+void AssetStreamer::work() {
+  while (true) {
+    Job job;
+
+    {
+      std::unique_lock<std::mutex> lock(m_jobMutex);
+      m_jobSignal.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+
+      if (m_stopping) {
+        return;
+      }
+
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    LoadedAsset asset = {};
+    asset.type = job.type;
+    asset.handle = job.handle;
+
+    switch (job.type) {
+    case AssetType::Mesh:
+      asset.failed = !loadMesh(job.path, asset.mesh);
+      break;
+    case AssetType::Texture:
+      asset.failed = !loadTexture(job.path, asset.texture);
+      break;
+    }
+
+    if (asset.failed) {
+      printf("ERROR: Streaming %s\n", job.path.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(m_loadedMutex);
+    m_loaded.push_back(std::move(asset));
+  }
+}
+
+bool AssetStreamer::loadMesh(const std::string &path, MeshData &mesh) {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string warn, err;
+
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                        path.c_str())) {
+    printf("ERROR: %s", err.c_str());
+    return false;
+  }
+
+  std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+
+  for (tinyobj::shape_t &shape : shapes) {
+    for (tinyobj::index_t &index : shape.mesh.indices) {
+      Vertex vertex = {};
+
+      vertex.pos = {attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2]};
+
+      vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
+                         1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+
+      vertex.color = {1.0f, 1.0f, 1.0f};
+
+      if (uniqueVertices.count(vertex) == 0) {
+        uniqueVertices[vertex] = static_cast<uint32_t>(mesh.vertices.size());
+        mesh.vertices.push_back(vertex);
+      }
+
+      mesh.indices.push_back(uniqueVertices[vertex]);
+    }
+  }
+
+  // Nothing to draw, the asset keeps its placeholder
+  if (mesh.indices.empty()) {
+    printf("ERROR: %s has no faces\n", path.c_str());
+    return false;
+  }
+
+  Lod::build(mesh.vertices, mesh.indices, mesh.meshlets, mesh.lods);
+  mesh.occluderIndices = Lod::occluder(mesh.vertices, mesh.indices, mesh.lods);
+  Vertices::split(mesh.vertices, mesh.positions, mesh.attributes);
+
+  return true;
+}
+
+bool AssetStreamer::loadTexture(const std::string &path,
+                                TextureData &texture) {
+  int texWidth, texHeight, texChannels;
+  stbi_uc *pixels = stbi_load(path.c_str(), &texWidth, &texHeight,
+                              &texChannels, STBI_rgb_alpha);
+
+  if (!pixels) {
+    return false;
+  }
+
+  texture.width = texWidth;
+  texture.height = texHeight;
+  texture.pixels.resize((size_t)texWidth * texHeight * 4);
+  memcpy(texture.pixels.data(), pixels, texture.pixels.size());
+
+  stbi_image_free(pixels);
+
+  generateMips(texture);
+
+  return true;
+}
+
+void AssetStreamer::generateMips(TextureData &texture) {
+  uint32_t levels = 1;
+  while ((std::max(texture.width, texture.height) >> levels) > 0) {
+    levels++;
+  }
+
+  size_t total = 0;
+  texture.mipOffsets.resize(levels);
+  for (uint32_t level = 0; level < levels; ++level) {
+    texture.mipOffsets[level] = total;
+    total += (size_t)texture.mipWidth(level) * texture.mipHeight(level) * 4;
+  }
+
+  texture.pixels.resize(total);
+
+  // 2x2 box filter, odd edges reuse the last row or column
+  for (uint32_t level = 1; level < levels; ++level) {
+    const uint8_t *src = texture.pixels.data() + texture.mipOffsets[level - 1];
+    uint8_t *dst = texture.pixels.data() + texture.mipOffsets[level];
+
+    uint32_t srcWidth = texture.mipWidth(level - 1);
+    uint32_t srcHeight = texture.mipHeight(level - 1);
+    uint32_t dstWidth = texture.mipWidth(level);
+    uint32_t dstHeight = texture.mipHeight(level);
+
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+      uint32_t y0 = std::min(y * 2, srcHeight - 1);
+      uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+
+      for (uint32_t x = 0; x < dstWidth; ++x) {
+        uint32_t x0 = std::min(x * 2, srcWidth - 1);
+        uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+
+        for (uint32_t c = 0; c < 4; ++c) {
+          uint32_t sum = src[(y0 * srcWidth + x0) * 4 + c] +
+                         src[(y0 * srcWidth + x1) * 4 + c] +
+                         src[(y1 * srcWidth + x0) * 4 + c] +
+                         src[(y1 * srcWidth + x1) * 4 + c];
+          dst[(y * dstWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef VULKAN_STREAMING_H
+#define VULKAN_STREAMING_H
+
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "vertices.h"
+#include "lod.h"
+
+typedef uint32_t MeshHandle;
+typedef uint32_t TextureHandle;
+
+enum class AssetType {
+  Mesh,
+  Texture
+};
+
+struct MeshData {
+  std::vector< Vertex >   vertices;
+  // The vertices split into the streams the GPU reads
+  std::vector< VertexPosition >   positions;
+  std::vector< VertexAttributes > attributes;
+  // Every LOD level one after the other, ordered by meshlet
+  std::vector< uint32_t > indices;
+  std::vector< Meshlet >  meshlets;
+  std::vector< MeshLod >  lods;
+  // Rasterized by the software occlusion, never covers more than level 0
+  std::vector< uint32_t > occluderIndices;
+};
+
+// RGBA8 pixels of the whole mip chain, level 0 first and tightly packed
+struct TextureData {
+  uint32_t               width  = 0;
+  uint32_t               height = 0;
+  std::vector< uint8_t > pixels;
+  std::vector< size_t >  mipOffsets;
+
+  uint32_t mipLevels() const { return ( uint32_t )mipOffsets.size(); }
+  uint32_t mipWidth( uint32_t level ) const { return std::max( width >> level, 1u ); }
+  uint32_t mipHeight( uint32_t level ) const { return std::max( height >> level, 1u ); }
+};
+
+struct LoadedAsset {
+  AssetType   type;
+  uint32_t    handle;
+  bool        failed;
+  MeshData    mesh;
+  TextureData texture;
+};
+
+// Decodes assets from disk on a pool of worker threads. Requests are handed in
+// from the main thread and the decoded CPU side data is picked up with poll(),
+// creating and uploading the GPU resources stays the renderer's job.
+class AssetStreamer {
+public:
+  void start( uint32_t workerCount );
+  void stop();
+
+  void request( AssetType type, uint32_t handle, std::string path );
+  bool poll( LoadedAsset& asset );
+
+  static bool loadMesh( const std::string& path, MeshData& mesh );
+  static bool loadTexture( const std::string& path, TextureData& texture );
+  static void generateMips( TextureData& texture );
+
+private:
+  struct Job {
+    AssetType   type;
+    uint32_t    handle;
+    std::string path;
+  };
+
+  void work();
+
+  std::vector< std::thread > m_workers;
+  std::deque< Job >          m_jobs;
+  std::deque< LoadedAsset >  m_loaded;
+  std::mutex                 m_jobMutex;
+  std::mutex                 m_loadedMutex;
+  std::condition_variable    m_jobSignal;
+  bool                       m_stopping = false;
+};
+
+#endif //VULKAN_STREAMING_H
@@ -45,18 +45,45 @@ VkPhysicalDevice Utils::GetBestPhysicalDevice( VkInstance instance ) {
   return devices[maxIndex];
 }
 
-std::vector< char > Utils::readFile( std::string filename ) {
-  std::ifstream file( filename, std::ios::ate | std::ios::binary );
+uint32_t Utils::findMemoryType( VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties ) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties( physicalDevice, &memProperties );
 
-  if (!file.is_open()) {
-    throw std::runtime_error("Failed to locate shader...");
+  for( uint32_t i = 0; i < memProperties.memoryTypeCount; ++i ) {
+    if( ( typeFilter & ( 1 << i ) ) && ( memProperties.memoryTypes[i].propertyFlags & properties ) == properties ) {
+      return i;
+    }
   }
 
-  auto fileSize = file.tellg();
-  std::vector< char > buffer( ( long long int )fileSize );
-  file.seekg( 0 );
-  file.read( buffer.data(), fileSize );
-  file.close();
+  return UINT32_MAX;
+}
+
+bool Utils::hasInstanceExtension( const char* name ) {
+  uint32_t extensionCount;
+  vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, nullptr );
+  std::vector<VkExtensionProperties> extensions( extensionCount );
+  vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, extensions.data() );
 
-  return buffer;
-}
\ No newline at end of file
+  for( const VkExtensionProperties& extension : extensions ) {
+    if( strcmp( extension.extensionName, name ) == 0 ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool Utils::hasDeviceExtension( VkPhysicalDevice physicalDevice, const char* name ) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties( physicalDevice, nullptr, &extensionCount, nullptr );
+  std::vector<VkExtensionProperties> extensions( extensionCount );
+  vkEnumerateDeviceExtensionProperties( physicalDevice, nullptr, &extensionCount, extensions.data() );
+
+  for( const VkExtensionProperties& extension : extensions ) {
+    if( strcmp( extension.extensionName, name ) == 0 ) {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -10,11 +10,19 @@
 #include <printf.h>
 #include <vector>
 #include <string>
-#include <fstream>
+#include <cstring>
+
+#define VK_CHECK(value, info)                                                  \
+  if (value != VK_SUCCESS) {                                                   \
+    printf("ERROR: %s", info);                                                 \
+    exit(EXIT_FAILURE);                                                        \
+  }
 
 namespace Utils {
   VkPhysicalDevice GetBestPhysicalDevice( VkInstance instance );
-  std::vector< char > readFile( std::string filename );
+  uint32_t findMemoryType( VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties );
+  bool hasInstanceExtension( const char* name );
+  bool hasDeviceExtension( VkPhysicalDevice physicalDevice, const char* name );
 }
 
 #endif //VULKAN_UTILS_H
@@ -0,0 +1,200 @@
+#ifndef VULKAN_VERTEXLAYOUT_H
+#define VULKAN_VERTEXLAYOUT_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtc/type_aligned.hpp>
+
+#include "shaders.h"
+
+// Format a vertex member is read with and the bytes it reads, members of other
+// types don't compile. 8 and 16 bit vectors are read normalized.
+template< VkFormat Format, uint32_t Size >
+struct VertexFormatInfo {
+  static constexpr VkFormat format = Format;
+  static constexpr uint32_t size   = Size;
+};
+
+template< typename T > struct VertexFormat;
+
+template<> struct VertexFormat< float >    : VertexFormatInfo< VK_FORMAT_R32_SFLOAT, 4 > {};
+template<> struct VertexFormat< int32_t >  : VertexFormatInfo< VK_FORMAT_R32_SINT, 4 > {};
+template<> struct VertexFormat< uint32_t > : VertexFormatInfo< VK_FORMAT_R32_UINT, 4 > {};
+
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 2, float, Q > >    : VertexFormatInfo< VK_FORMAT_R32G32_SFLOAT, 8 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 3, float, Q > >    : VertexFormatInfo< VK_FORMAT_R32G32B32_SFLOAT, 12 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 4, float, Q > >    : VertexFormatInfo< VK_FORMAT_R32G32B32A32_SFLOAT, 16 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 2, int32_t, Q > >  : VertexFormatInfo< VK_FORMAT_R32G32_SINT, 8 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 3, int32_t, Q > >  : VertexFormatInfo< VK_FORMAT_R32G32B32_SINT, 12 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 4, int32_t, Q > >  : VertexFormatInfo< VK_FORMAT_R32G32B32A32_SINT, 16 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 2, uint32_t, Q > > : VertexFormatInfo< VK_FORMAT_R32G32_UINT, 8 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 3, uint32_t, Q > > : VertexFormatInfo< VK_FORMAT_R32G32B32_UINT, 12 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 4, uint32_t, Q > > : VertexFormatInfo< VK_FORMAT_R32G32B32A32_UINT, 16 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 2, uint16_t, Q > > : VertexFormatInfo< VK_FORMAT_R16G16_UNORM, 4 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 2, int16_t, Q > >  : VertexFormatInfo< VK_FORMAT_R16G16_SNORM, 4 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 4, uint8_t, Q > >  : VertexFormatInfo< VK_FORMAT_R8G8B8A8_UNORM, 4 > {};
+template< glm::qualifier Q > struct VertexFormat< glm::vec< 4, int8_t, Q > >   : VertexFormatInfo< VK_FORMAT_R8G8B8A8_SNORM, 4 > {};
+
+enum VertexNumeric {
+  VERTEX_NUMERIC_FLOAT,
+  VERTEX_NUMERIC_SINT,
+  VERTEX_NUMERIC_UINT,
+  VERTEX_NUMERIC_UNKNOWN
+};
+
+struct VertexFormatClass {
+  VertexNumeric numeric;
+  uint32_t      components;
+};
+
+// How a vertex shader input reads a format, normalized formats read as floats
+constexpr VertexFormatClass vertexFormatClass( VkFormat format ) {
+  switch( format ) {
+    case VK_FORMAT_R32_SFLOAT:          return { VERTEX_NUMERIC_FLOAT, 1 };
+    case VK_FORMAT_R32G32_SFLOAT:       return { VERTEX_NUMERIC_FLOAT, 2 };
+    case VK_FORMAT_R32G32B32_SFLOAT:    return { VERTEX_NUMERIC_FLOAT, 3 };
+    case VK_FORMAT_R32G32B32A32_SFLOAT: return { VERTEX_NUMERIC_FLOAT, 4 };
+    case VK_FORMAT_R16G16_UNORM:        return { VERTEX_NUMERIC_FLOAT, 2 };
+    case VK_FORMAT_R16G16_SNORM:        return { VERTEX_NUMERIC_FLOAT, 2 };
+    case VK_FORMAT_R8G8B8A8_UNORM:      return { VERTEX_NUMERIC_FLOAT, 4 };
+    case VK_FORMAT_R8G8B8A8_SNORM:      return { VERTEX_NUMERIC_FLOAT, 4 };
+    case VK_FORMAT_R32_SINT:            return { VERTEX_NUMERIC_SINT, 1 };
+    case VK_FORMAT_R32G32_SINT:         return { VERTEX_NUMERIC_SINT, 2 };
+    case VK_FORMAT_R32G32B32_SINT:      return { VERTEX_NUMERIC_SINT, 3 };
+    case VK_FORMAT_R32G32B32A32_SINT:   return { VERTEX_NUMERIC_SINT, 4 };
+    case VK_FORMAT_R32_UINT:            return { VERTEX_NUMERIC_UINT, 1 };
+    case VK_FORMAT_R32G32_UINT:         return { VERTEX_NUMERIC_UINT, 2 };
+    case VK_FORMAT_R32G32B32_UINT:      return { VERTEX_NUMERIC_UINT, 3 };
+    case VK_FORMAT_R32G32B32A32_UINT:   return { VERTEX_NUMERIC_UINT, 4 };
+    default:                            return { VERTEX_NUMERIC_UNKNOWN, 0 };
+  }
+}
+
+struct VertexAttribute {
+  uint32_t location;
+  VkFormat format;
+  uint32_t offset;
+  uint32_t size;
+};
+
+// One member of a vertex struct and the shader location it's read at
+#define VERTEX_ATTRIBUTE( Vertex, member, location )                                   \
+  VertexAttribute{ location, VertexFormat< decltype( Vertex::member ) >::format,       \
+                   ( uint32_t )offsetof( Vertex, member ),                              \
+                   VertexFormat< decltype( Vertex::member ) >::size }
+
+// A vertex struct declares its members once by specializing this with
+//   static constexpr VertexAttribute attributes[] = { VERTEX_ATTRIBUTE( ... ), ... };
+// right after the struct, and checks VertexInput< Vertex >::padding() is 0.
+template< typename Vertex > struct VertexLayout;
+
+// Descriptions of a vertex struct read from one binding, one struct per stream
+template< typename Vertex >
+struct VertexInput {
+  static constexpr uint32_t ATTRIBUTE_COUNT = sizeof( VertexLayout< Vertex >::attributes ) / sizeof( VertexAttribute );
+
+  static constexpr VkVertexInputBindingDescription binding( uint32_t binding ) {
+    return { binding, ( uint32_t )sizeof( Vertex ), VK_VERTEX_INPUT_RATE_VERTEX };
+  }
+
+  static constexpr std::array< VkVertexInputAttributeDescription, ATTRIBUTE_COUNT > attributes( uint32_t binding ) {
+    std::array< VkVertexInputAttributeDescription, ATTRIBUTE_COUNT > descriptions = {};
+    for( uint32_t i = 0; i < ATTRIBUTE_COUNT; ++i ) {
+      const VertexAttribute& attribute = VertexLayout< Vertex >::attributes[i];
+      descriptions[i] = { attribute.location, binding, attribute.format, attribute.offset };
+    }
+    return descriptions;
+  }
+
+  // Bytes of the stride no attribute reads, padded members and gaps between
+  // or after them all count
+  static constexpr uint32_t padding() {
+    uint32_t used = 0;
+    for( const VertexAttribute& attribute : VertexLayout< Vertex >::attributes ) {
+      if( attribute.offset + attribute.size > sizeof( Vertex ) ) {
+        return UINT32_MAX;
+      }
+      used += attribute.size;
+    }
+    return used > sizeof( Vertex ) ? UINT32_MAX : sizeof( Vertex ) - used;
+  }
+
+  static constexpr const VertexAttribute* find( uint32_t location ) {
+    for( const VertexAttribute& attribute : VertexLayout< Vertex >::attributes ) {
+      if( attribute.location == location ) {
+        return &attribute;
+      }
+    }
+    return nullptr;
+  }
+
+  // The attributes the shader reads, the others aren't fetched
+  static std::vector< VkVertexInputAttributeDescription > attributes( const ShaderReflection& shader, uint32_t binding ) {
+    std::vector< VkVertexInputAttributeDescription > descriptions;
+    for( const VkVertexInputAttributeDescription& description : attributes( binding ) ) {
+      for( uint32_t i = 0; i < shader.inputCount; ++i ) {
+        if( shader.inputs[i].location == description.location ) {
+          descriptions.push_back( description );
+        }
+      }
+    }
+    return descriptions;
+  }
+};
+
+// Vertex structs read from consecutive bindings, the first one from binding 0.
+// A pass only binds the streams its vertex shader reads.
+template< typename... Streams >
+struct VertexStreams {
+  static constexpr const VertexAttribute* find( uint32_t location ) {
+    const VertexAttribute* attribute = nullptr;
+    ( ( attribute = attribute ? attribute : VertexInput< Streams >::find( location ) ), ... );
+    return attribute;
+  }
+
+  // Every input of the shader has a member in a stream read as the same type,
+  // with at least as many components. Reflection reports float inputs as
+  // 32 bit floats, normalized members provide them too.
+  static constexpr bool provides( const ShaderReflection& shader ) {
+    for( uint32_t i = 0; i < shader.inputCount; ++i ) {
+      const VertexAttribute* attribute = find( shader.inputs[i].location );
+      if( !attribute ) {
+        return false;
+      }
+
+      VertexFormatClass member = vertexFormatClass( attribute->format );
+      VertexFormatClass input  = vertexFormatClass( shader.inputs[i].format );
+      if( member.numeric == VERTEX_NUMERIC_UNKNOWN || member.numeric != input.numeric || member.components < input.components ) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void inputs( const ShaderReflection& shader, std::vector< VkVertexInputBindingDescription >& bindings, std::vector< VkVertexInputAttributeDescription >& attributes ) {
+    uint32_t binding = 0;
+    ( addInputs< Streams >( shader, binding++, bindings, attributes ), ... );
+  }
+
+private:
+  template< typename Vertex >
+  static void addInputs( const ShaderReflection& shader, uint32_t binding, std::vector< VkVertexInputBindingDescription >& bindings, std::vector< VkVertexInputAttributeDescription >& attributes ) {
+    std::vector< VkVertexInputAttributeDescription > read = VertexInput< Vertex >::attributes( shader, binding );
+    if( read.empty() ) {
+      return;
+    }
+
+    bindings.push_back( VertexInput< Vertex >::binding( binding ) );
+    attributes.insert( attributes.end(), read.begin(), read.end() );
+  }
+};
+
+#endif //VULKAN_VERTEXLAYOUT_H
@@ -4,6 +4,23 @@
 
 #include "vertices.h"
 
+#include "shaders/depth.vert.reflect.h"
+#include "shaders/triangle.vert.reflect.h"
+
+static_assert( MeshStreams::provides( triangle_vert_reflection ), "The mesh streams don't match the inputs of triangle.vert" );
+static_assert( MeshStreams::provides( depth_vert_reflection ), "The mesh streams don't match the inputs of depth.vert" );
+
+void Vertices::split( const std::vector< Vertex >& vertices, std::vector< VertexPosition >& positions, std::vector< VertexAttributes >& attributes ) {
+  positions.resize( vertices.size() );
+  attributes.resize( vertices.size() );
+
+  for( size_t i = 0; i < vertices.size(); ++i ) {
+    positions[i].pos       = vertices[i].pos;
+    attributes[i].color    = vertices[i].color;
+    attributes[i].texCoord = vertices[i].texCoord;
+  }
+}
+
 Shader Vertices::GetTriangle() {
   Shader triangle;
   triangle.shader = {
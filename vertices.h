@@ -11,14 +11,19 @@
 #include <array>
 
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_ENABLE_EXPERIMENTAL
 #define GLM_HAS_CXX11_STL 1
 #include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
 
+#include "vertexlayout.h"
+
+// Vertex as loaded, the GPU reads it split into the streams below
 struct Vertex {
 public:
-  alignas(16) glm::vec3 pos{};
-  alignas(16) glm::vec3 color{};
-  alignas(16) glm::vec2 texCoord{};
+  glm::packed_vec3 pos{};
+  glm::packed_vec3 color{};
+  glm::packed_vec2 texCoord{};
   /*
   Vertex( glm::vec3 position, glm::vec3 colors, glm::vec2 texCoords ) {
     pos      = position;
@@ -27,36 +32,55 @@ public:
   }
    */
 
-  static VkVertexInputBindingDescription getBindingDescription() {
-    VkVertexInputBindingDescription bindingDescription = {};
-    bindingDescription.binding                         = 0;
-    bindingDescription.stride                          = sizeof( Vertex );
-    bindingDescription.inputRate                       = VK_VERTEX_INPUT_RATE_VERTEX;
-    return bindingDescription;
-  }
-
-  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-    attributeDescriptions[0].binding                                       = 0;
-    attributeDescriptions[0].location                                      = 0;
-    attributeDescriptions[0].format                                        = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset                                        = offsetof(Vertex, pos);
-    attributeDescriptions[1].binding                                       = 0;
-    attributeDescriptions[1].location                                      = 1;
-    attributeDescriptions[1].format                                        = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset                                        = offsetof(Vertex, color);
-    attributeDescriptions[2].binding                                       = 0;
-    attributeDescriptions[2].location                                      = 2;
-    attributeDescriptions[2].format                                        = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset                                        = offsetof(Vertex, texCoord);
-    return attributeDescriptions;
-  }
-
   bool operator==(const Vertex& other) const {
     return pos == other.pos && color == other.color && texCoord == other.texCoord;
   }
 };
 
+// Positions get a stream of their own, depth only passes fetch nothing else.
+// Members are packed, the aligned glm types would pad the streams.
+struct VertexPosition {
+  glm::packed_vec3 pos{};
+};
+
+struct VertexAttributes {
+  glm::packed_vec3 color{};
+  glm::packed_vec2 texCoord{};
+};
+
+template<> struct VertexLayout< VertexPosition > {
+  static constexpr VertexAttribute attributes[] = {
+    VERTEX_ATTRIBUTE( VertexPosition, pos, 0 )
+  };
+};
+
+template<> struct VertexLayout< VertexAttributes > {
+  static constexpr VertexAttribute attributes[] = {
+    VERTEX_ATTRIBUTE( VertexAttributes, color, 1 ),
+    VERTEX_ATTRIBUTE( VertexAttributes, texCoord, 2 )
+  };
+};
+
+static_assert( VertexInput< VertexPosition >::padding() == 0, "VertexPosition has bytes no attribute reads" );
+static_assert( VertexInput< VertexAttributes >::padding() == 0, "VertexAttributes has bytes no attribute reads" );
+
+// The pulling vertex shaders decode the streams as runs of 3 and 5 floats
+static_assert( sizeof( VertexPosition ) == 3 * sizeof( float ), "triangle.vert pulls positions as 3 floats" );
+static_assert( sizeof( VertexAttributes ) == 5 * sizeof( float ), "triangle.vert pulls attributes as 5 floats" );
+
+// Binding 0 holds positions, binding 1 the other attributes
+typedef VertexStreams< VertexPosition, VertexAttributes > MeshStreams;
+
+namespace std {
+  template<> struct hash<Vertex> {
+    size_t operator()(Vertex const& vertex) const {
+      return ((hash<glm::vec3>()(vertex.pos) ^
+               (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+             (hash<glm::vec2>()(vertex.texCoord) << 1);
+    }
+  };
+}
+
 struct Shader {
 public:
   std::vector<Vertex> shader;
@@ -67,6 +91,9 @@ public:
 };
 
 namespace Vertices {
+  // De-interleaves loaded vertices into the streams of MeshStreams
+  void split( const std::vector< Vertex >& vertices, std::vector< VertexPosition >& positions, std::vector< VertexAttributes >& attributes );
+
   Shader GetTriangle();
   Shader GetRectangle();
   Shader GetPent();
@@ -1,22 +1,20 @@
 #include "vulkan.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "submodules/tiny_obj_loader/tiny_obj_loader.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "submodules/stb-lib/stb_image.h"
-
-const char *FRAG = "triangle.frag.spv";
-const char *VERT = "triangle.vert.spv";
+#include "shaders/cull.comp.reflect.h"
+#include "shaders/depthpyramid.comp.reflect.h"
+#include "shaders/triangle.vert.reflect.h"
+
+const char *FRAG = "triangle.frag";
+const char *VERT = "triangle.vert";
+const char *BINDLESS_FRAG = "bindless.frag";
+const char *CULL_COMP = "cull.comp";
+const char *DEPTH_PYRAMID_COMP = "depthpyramid.comp";
+const char *DEPTH_VERT = "depth.vert";
+const char *PULL_VERT = "triangle.pull.vert";
+const char *DEPTH_PULL_VERT = "depth.pull.vert";
 const char *TEXT = "chalet.jpg";
 const char *OBJ = "chalet.mdl";
 
-#define VK_CHECK(value, info)                                                  \
-  if (value != VK_SUCCESS) {                                                   \
-    printf("ERROR: %s", info);                                                 \
-    exit(EXIT_FAILURE);                                                        \
-  }
-
 void Vulkan::run(uint32_t width, uint32_t height, char *name) {
   initGLFW(width, height, name);
   initVulkan();
@@ -26,7 +24,6 @@ void Vulkan::run(uint32_t width, uint32_t height, char *name) {
 
 void Vulkan::initVulkan() {
   // Shader loading
-  // m_triangle  = Vertices::GetRectangle();
   m_rectangle = Vertices::GetRectangle();
 
   // Vulkan loading
@@ -37,21 +34,62 @@ void Vulkan::initVulkan() {
   createDevice();
   createSwapchain();
   createImageView();
-  createRenderPass();
+  if (!m_dynamicRendering) {
+    createRenderPass();
+  }
+  createDescriptorAllocators();
   createDescriptorSetLayout();
+
+  // Pipelines compile on every core, the main thread only waits for them
+  uint32_t cores = std::thread::hardware_concurrency();
+  m_pipelineCompiler.start(m_device, std::max(cores, 1u));
+
   createGraphicsPipeline();
   createCommandPool();
+  createUploadScheduler();
+  createTextureResidency();
+  createSceneBuffers();
+  createGeometryPool();
+  createCullingPipeline();
+  createDepthPyramidPipeline();
   createDepthResources();
-  createFrameBuffers();
-  createTextureImage();
-  createTextureImageView();
+  createDepthPyramid();
+  if (!m_dynamicRendering) {
+    createFrameBuffers();
+  }
   createTextureSampler();
-  loadModel();
-  createVertexBuffer();
-  createIndexBuffer();
+  createPlaceholders();
+  createBindlessDescriptors();
+
+  // Only the placeholders are waited on, the real assets fill in while drawing
+  m_streamer.start(cores > 1 ? cores - 1 : 1);
+  if (!m_gpuDriven) {
+    m_occlusion.start(cores > 1 ? cores - 1 : 0);
+  }
+  m_model = requestMesh(OBJ);
+  m_modelTexture = requestTexture(TEXT);
+
+  // Every other object of the grid is drawn flat, without the texture and the
+  // vertex colors
+  MaterialHandle textured = createMaterial(
+      {MATERIAL_VERTEX_COLOR | MATERIAL_TEXTURE, glm::vec4(1.0f)});
+  MaterialHandle flat = createMaterial({0, glm::vec4(0.8f, 0.6f, 0.4f, 1.0f)});
+
+  glm::mat4 modelTransform = glm::translate(
+      glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(1, 0, 0)),
+      glm::vec3(0, 0, -1));
+  for (uint32_t x = 0; x < sceneGridSize; ++x) {
+    for (uint32_t z = 0; z < sceneGridSize; ++z) {
+      glm::vec3 offset(x * SCENE_GRID_SPACING, 0, -(z * SCENE_GRID_SPACING));
+      addObject(m_model, m_modelTexture, (x + z) % 2 ? flat : textured,
+                glm::translate(glm::mat4(1), offset) * modelTransform);
+    }
+  }
+
+  updateScene();
+  m_uploads.flush();
+
   createUniformBuffers();
-  createDescriptorPool();
-  createDescriptorSets();
   createCommandBuffers();
   createSyncObjects();
 }
@@ -103,7 +141,12 @@ void Vulkan::main() {
 
       std::string title =
           "FPS: " + std::to_string((int)frameRate + 1) +
-          " AVG FRAME TIME: " + std::to_string(averageFrameTimeMilliseconds);
+          " AVG FRAME TIME: " + std::to_string(averageFrameTimeMilliseconds) +
+          " BINDS P/D/V: " + std::to_string(m_bindCounts.pipelines) + "/" +
+          std::to_string(m_bindCounts.descriptorSets) + "/" +
+          std::to_string(m_bindCounts.vertexBuffers) +
+          " DRAWS: " + std::to_string(m_bindCounts.draws) +
+          (depthPrepass ? " DEPTH PRE-PASS" : "");
 
       glfwSetWindowTitle(m_window, title.c_str());
     }
@@ -113,20 +156,77 @@ void Vulkan::main() {
 }
 
 void Vulkan::destroy() {
+  m_streamer.stop();
+
   invalidateSwapchain();
+  destroyGraphicsPipeline();
+  m_pipelineCompiler.stop();
+
+  m_uploads.destroy();
 
-  vkDestroyImage(m_device, m_textureImage, nullptr);
-  vkFreeMemory(m_device, m_textureImageMemory, nullptr);
-  vkDestroyImageView(m_device, m_textureImageView, nullptr);
+  for (Texture &texture : m_textures) {
+    destroyTexture(texture);
+  }
+  destroyTexture(m_placeholderTexture);
   vkDestroySampler(m_device, m_textureSampler, nullptr);
 
+  for (size_t i = 0; i < m_uniformBuffers.size(); ++i) {
+    vkDestroyBuffer(m_device, m_uniformBuffers[i], nullptr);
+    vkFreeMemory(m_device, m_uniformMemory[i], nullptr);
+  }
+
+  m_descriptorCache.destroy();
+  m_cachedDescriptors.destroy();
+  for (DescriptorAllocator &allocator : m_frameDescriptors) {
+    allocator.destroy();
+  }
+
   vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+  if (m_bindless) {
+    vkDestroyDescriptorPool(m_device, m_bindlessPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_bindlessSetLayout, nullptr);
+  }
 
-  vkDestroyBuffer(m_device, m_indexBuffer, nullptr);
-  vkFreeMemory(m_device, m_indexMemory, nullptr);
+  for (Mesh &mesh : m_meshes) {
+    destroyMesh(mesh);
+  }
+  destroyMesh(m_placeholderMesh);
+
+  vkDestroyBuffer(m_device, m_geometryVertexBuffer, nullptr);
+  vkFreeMemory(m_device, m_geometryVertexMemory, nullptr);
+  vkDestroyBuffer(m_device, m_geometryIndexBuffer, nullptr);
+  vkFreeMemory(m_device, m_geometryIndexMemory, nullptr);
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    vkDestroyBuffer(m_device, m_objectBuffers[i], nullptr);
+    vkFreeMemory(m_device, m_objectMemory[i], nullptr);
+  }
 
-  vkDestroyBuffer(m_device, m_vertexBuffer, nullptr);
-  vkFreeMemory(m_device, m_vertexMemory, nullptr);
+  if (m_gpuDriven) {
+    vkDestroyPipeline(m_device, m_depthPyramidPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_depthPyramidPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_depthPyramidSetLayout, nullptr);
+    vkDestroySampler(m_device, m_depthSampler, nullptr);
+
+    vkDestroyPipeline(m_device, m_cullPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_cullPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_cullSetLayout, nullptr);
+
+    vkDestroyBuffer(m_device, m_drawCommandBuffer, nullptr);
+    vkFreeMemory(m_device, m_drawCommandMemory, nullptr);
+    vkDestroyBuffer(m_device, m_drawCountBuffer, nullptr);
+    vkFreeMemory(m_device, m_drawCountMemory, nullptr);
+    vkDestroyBuffer(m_device, m_cullBuffer, nullptr);
+    vkFreeMemory(m_device, m_cullMemory, nullptr);
+    vkDestroyBuffer(m_device, m_meshletBuffer, nullptr);
+    vkFreeMemory(m_device, m_meshletMemory, nullptr);
+    vkDestroyBuffer(m_device, m_cullStatsBuffer, nullptr);
+    vkFreeMemory(m_device, m_cullStatsMemory, nullptr);
+  } else {
+    vkDestroyBuffer(m_device, m_instanceBuffer, nullptr);
+    vkFreeMemory(m_device, m_instanceMemory, nullptr);
+    m_occlusion.stop();
+  }
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], nullptr);
@@ -145,6 +245,8 @@ void Vulkan::destroy() {
 }
 
 void Vulkan::invalidateSwapchain() {
+  destroyDepthPyramid();
+
   vkDestroyImageView(m_device, m_depthImageView, nullptr);
   vkDestroyImage(m_device, m_depthImage, nullptr);
   vkFreeMemory(m_device, m_depthImageMemory, nullptr);
@@ -153,27 +255,41 @@ void Vulkan::invalidateSwapchain() {
     vkDestroyFramebuffer(m_device, buffer, nullptr);
   }
 
-  vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
-
   vkFreeCommandBuffers(m_device, m_commandPool,
                        static_cast<uint32_t>(m_commandBuffers.size()),
                        m_commandBuffers.data());
-  vkDestroyPipeline(m_device, m_pipeline, nullptr);
-  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
-  vkDestroyRenderPass(m_device, m_renderPass, nullptr);
 
   for (VkImageView view : m_swapchainImageViews) {
     vkDestroyImageView(m_device, view, nullptr);
   }
 
-  for (size_t i = 0; i < m_swapchainImages.size(); ++i) {
-    vkDestroyBuffer(m_device, m_uniformBuffers[i], nullptr);
-    vkFreeMemory(m_device, m_uniformMemory[i], nullptr);
-  }
-
   vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
 }
 
+void Vulkan::destroyGraphicsPipeline() {
+  // Builds still running read the render pass and the layout
+  m_pipelineCompiler.wait();
+  updatePipelines();
+
+  for (uint32_t i = 0; i < m_variantFeatures.size(); ++i) {
+    if (m_colorPipelines[i] != m_genericColorPipeline) {
+      vkDestroyPipeline(m_device, m_colorPipelines[i], nullptr);
+    }
+    if (m_prepassColorPipelines[i] != m_genericPrepassColorPipeline) {
+      vkDestroyPipeline(m_device, m_prepassColorPipelines[i], nullptr);
+    }
+  }
+  vkDestroyPipeline(m_device, m_genericColorPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_genericPrepassColorPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_depthPrepassPipeline, nullptr);
+  vkDestroyShaderModule(m_device, m_sceneVertShader, nullptr);
+  vkDestroyShaderModule(m_device, m_sceneFragShader, nullptr);
+  vkDestroyShaderModule(m_device, m_depthVertShader, nullptr);
+  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+  vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+  m_renderPass = VK_NULL_HANDLE;
+}
+
 void Vulkan::createInstance() {
   std::vector<const char *> extensions = getExtensions();
 
@@ -183,19 +299,36 @@ void Vulkan::createInstance() {
   extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #endif
 
+  // Needed to query VK_EXT_memory_budget on a 1.0 instance
+  m_hasProperties2 = Utils::hasInstanceExtension(
+      VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  if (m_hasProperties2) {
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  }
+
   std::vector<const char *> layers;
   // layers.push_back( "VK_LAYER_LUNARG_monitor" );
 #ifndef NDEBUG
   layers.push_back("VK_LAYER_LUNARG_standard_validation");
 #endif
 
+  // Dynamic rendering wants 1.3, or 1.2 for its extension. 1.0 loaders don't
+  // have vkEnumerateInstanceVersion.
+  auto enumerateVersion =
+      (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(
+          nullptr, "vkEnumerateInstanceVersion");
+  if (enumerateVersion != nullptr) {
+    VK_CHECK(enumerateVersion(&m_apiVersion), "Enumerating instance version");
+    m_apiVersion = std::min(m_apiVersion, (uint32_t)VK_API_VERSION_1_3);
+  }
+
   VkApplicationInfo appInfo = {};
   appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
   appInfo.pApplicationName = "VK_KOSTA";
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "________";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = m_apiVersion;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -280,8 +413,94 @@ void Vulkan::createDevice() {
   std::vector<const char *> extensions;
   extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+  // Culling on the GPU writes one indirect command per object, the object
+  // index is passed as the first instance
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
+  m_gpuDriven = gpuDrivenRendering && supportedFeatures.multiDrawIndirect &&
+                supportedFeatures.drawIndirectFirstInstance;
+  if (m_gpuDriven) {
+    deviceFeatures.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+    m_hasDrawIndirectCount = Utils::hasDeviceExtension(
+        m_physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (m_hasDrawIndirectCount) {
+      extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+  }
+
+  // Vertex shaders reading storage buffers is core, nothing to turn on
+  m_vertexPulling = vertexPulling;
+
+  // Only the features the texture array needs are turned on
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+  m_bindless = bindlessTextures && queryBindlessSupport();
+  if (m_bindless) {
+    extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  }
+
+  // Sets are written from an array of infos with one call
+  m_hasUpdateTemplates = Utils::hasDeviceExtension(
+      m_physicalDevice, VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+  if (m_hasUpdateTemplates) {
+    extensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+  }
+
+  // Attachments are begun in the command buffer, viewport, scissor and cull
+  // mode are set there too
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR renderingFeatures = {};
+  renderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+  dynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+  m_dynamicRendering = dynamicRendering && queryDynamicRenderingSupport();
+  if (m_dynamicRendering) {
+    renderingFeatures.dynamicRendering = VK_TRUE;
+    if (!m_dynamicRenderingCore) {
+      extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+      extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+      dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+    }
+  }
+
+  void *features = nullptr;
+  if (m_bindless) {
+    indexingFeatures.pNext = features;
+    features = &indexingFeatures;
+  }
+  if (m_dynamicRendering) {
+    renderingFeatures.pNext = features;
+    features = &renderingFeatures;
+  }
+  if (m_dynamicRendering && !m_dynamicRenderingCore) {
+    dynamicStateFeatures.pNext = features;
+    features = &dynamicStateFeatures;
+  }
+
+  m_hasMemoryBudget =
+      m_hasProperties2 && Utils::hasDeviceExtension(
+                              m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (m_hasMemoryBudget) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = features;
   createInfo.pQueueCreateInfos = &queueCreateInfo;
   createInfo.queueCreateInfoCount = 1;
   createInfo.pEnabledFeatures = &deviceFeatures;
@@ -293,6 +512,118 @@ void Vulkan::createDevice() {
 
   vkGetDeviceQueue(m_device, indices.graphicsFamily, 0, &m_graphicsQueue);
   vkGetDeviceQueue(m_device, indices.presentFamily, 0, &m_presentQueue);
+
+  if (m_hasDrawIndirectCount) {
+    m_drawIndexedIndirectCount =
+        (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            m_device, "vkCmdDrawIndexedIndirectCountKHR");
+  }
+
+  if (m_dynamicRendering) {
+    m_cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(
+        m_device, m_dynamicRenderingCore ? "vkCmdBeginRendering"
+                                         : "vkCmdBeginRenderingKHR");
+    m_cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(
+        m_device,
+        m_dynamicRenderingCore ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR");
+    m_cmdSetCullMode = (PFN_vkCmdSetCullModeEXT)vkGetDeviceProcAddr(
+        m_device,
+        m_dynamicRenderingCore ? "vkCmdSetCullMode" : "vkCmdSetCullModeEXT");
+  }
+}
+
+bool Vulkan::queryBindlessSupport() {
+  if (!m_hasProperties2 ||
+      !Utils::hasDeviceExtension(m_physicalDevice,
+                                 VK_KHR_MAINTENANCE3_EXTENSION_NAME) ||
+      !Utils::hasDeviceExtension(m_physicalDevice,
+                                 VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+    return false;
+  }
+
+  auto getFeatures2 =
+      (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+          m_instance, "vkGetPhysicalDeviceFeatures2KHR");
+  auto getProperties2 =
+      (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+          m_instance, "vkGetPhysicalDeviceProperties2KHR");
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+  VkPhysicalDeviceFeatures2KHR features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features.pNext = &indexingFeatures;
+  getFeatures2(m_physicalDevice, &features);
+
+  if (!features.features.shaderSampledImageArrayDynamicIndexing ||
+      !indexingFeatures.shaderSampledImageArrayNonUniformIndexing ||
+      !indexingFeatures.runtimeDescriptorArray ||
+      !indexingFeatures.descriptorBindingPartiallyBound ||
+      !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind) {
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+  indexingProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+  VkPhysicalDeviceProperties2KHR properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+  properties.pNext = &indexingProperties;
+  getProperties2(m_physicalDevice, &properties);
+
+  // Combined image samplers count against both the sampler and image limits
+  m_bindlessCapacity = std::min(
+      {MAX_BINDLESS_TEXTURES,
+       indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+       indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+       indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+       indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+
+  return true;
+}
+
+bool Vulkan::queryDynamicRenderingSupport() {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+  uint32_t version = std::min(properties.apiVersion, m_apiVersion);
+
+  // The extensions' own dependencies are core in 1.2, older devices keep the
+  // render pass
+  m_dynamicRenderingCore = version >= VK_API_VERSION_1_3;
+  if (!m_dynamicRenderingCore &&
+      (version < VK_API_VERSION_1_2 ||
+       !Utils::hasDeviceExtension(m_physicalDevice,
+                                  VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) ||
+       !Utils::hasDeviceExtension(
+           m_physicalDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME))) {
+    return false;
+  }
+
+  // Extended dynamic state has no feature to check once it's core
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+  dynamicStateFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR renderingFeatures = {};
+  renderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  renderingFeatures.pNext =
+      m_dynamicRenderingCore ? nullptr : &dynamicStateFeatures;
+
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+      m_instance, "vkGetPhysicalDeviceFeatures2");
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &renderingFeatures;
+  getFeatures2(m_physicalDevice, &features);
+
+  return renderingFeatures.dynamicRendering &&
+         dynamicStateFeatures.extendedDynamicState;
 }
 
 void Vulkan::createSurface() {
@@ -425,7 +756,7 @@ void Vulkan::createImageView() {
   for (uint32_t i = 0; i < m_swapchainImages.size(); ++i) {
     m_swapchainImageViews[i] =
         createImageView(m_swapchainImages[i], m_swapchainImageFormat,
-                        VK_IMAGE_ASPECT_COLOR_BIT);
+                        VK_IMAGE_ASPECT_COLOR_BIT, 1);
   }
 }
 
@@ -443,7 +774,9 @@ void Vulkan::createRenderPass() {
   depthAttachment.format = findDepthFormat();
   depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  // Kept for the depth pyramid of the occlusion culling
+  depthAttachment.storeOp = m_gpuDriven ? VK_ATTACHMENT_STORE_OP_STORE
+                                        : VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -492,29 +825,100 @@ void Vulkan::createRenderPass() {
 }
 
 void Vulkan::createGraphicsPipeline() {
-  VkVertexInputBindingDescription bindingDescription =
-      Vertex::getBindingDescription();
-  std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions =
-      Vertex::getAttributeDescriptions();
+  // Read by the builds, which don't otherwise depend on the swapchain
+  m_sceneColorFormat = m_swapchainImageFormat;
+
+  // Kept for the variants created later on
+  createShaderModule(sceneVertexShader(false), &m_sceneVertShader);
+  createShaderModule(m_bindless ? BINDLESS_FRAG : FRAG, &m_sceneFragShader);
+  createShaderModule(sceneVertexShader(true), &m_depthVertShader);
+
+  // The bindless texture array is set 1, objects carry their texture slot
+  std::vector<VkDescriptorSetLayout> setLayouts = {m_descriptorSetLayout};
+  if (m_bindless) {
+    setLayouts.push_back(m_bindlessSetLayout);
+  }
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  // The object of single object draws
+  std::vector<VkPushConstantRange> drawRanges = Shaders::pushConstantRanges(
+      {sceneVertexShader(false), sceneVertexShader(true)});
+
+  pipelineLayoutInfo.setLayoutCount = setLayouts.size();
+  pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = drawRanges.size();
+  pipelineLayoutInfo.pPushConstantRanges = drawRanges.data();
+
+  VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr,
+                                  &m_pipelineLayout),
+           "Creating pipeline layout");
+
+  // Needed before the first frame, they compile side by side
+  std::shared_future<VkPipeline> depthPrepass =
+      compileScenePipeline(0, SCENE_PASS_DEPTH_PREPASS);
+  std::shared_future<VkPipeline> genericColor =
+      compileScenePipeline(GENERIC_FEATURES, SCENE_PASS_COLOR);
+  std::shared_future<VkPipeline> genericPrepassColor =
+      compileScenePipeline(GENERIC_FEATURES, SCENE_PASS_PREPASS_COLOR);
+
+  m_depthPrepassPipeline = depthPrepass.get();
+  m_genericColorPipeline = genericColor.get();
+  m_genericPrepassColorPipeline = genericPrepassColor.get();
+
+  // Variants in use before the swapchain was recreated are queued again
+  m_pendingPipelines.clear();
+  m_colorPipelines.clear();
+  m_prepassColorPipelines.clear();
+  m_depthPipelines.clear();
+  for (uint32_t features : m_variantFeatures) {
+    createVariantPipelines(features);
+  }
+}
+
+VkPipeline Vulkan::createScenePipeline(uint32_t features, ScenePass pass,
+                                       VkPipelineCache cache) {
+  // The depth pre-pass reads the position stream only, pulling shaders have
+  // no inputs and the vertex input state stays empty
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  MeshStreams::inputs(
+      Shaders::get(sceneVertexShader(pass == SCENE_PASS_DEPTH_PREPASS))
+          .reflection,
+      bindingDescriptions, attributeDescriptions);
+
+  // Every feature bit is a boolean constant, its bit index is the constant_id
+  const uint32_t CONSTANT_COUNT = MATERIAL_FEATURE_COUNT + 1;
+  VkBool32 featureValues[CONSTANT_COUNT];
+  VkSpecializationMapEntry featureEntries[CONSTANT_COUNT];
+  for (uint32_t i = 0; i < CONSTANT_COUNT; ++i) {
+    featureValues[i] = (features >> i) & 1;
+    featureEntries[i].constantID = i;
+    featureEntries[i].offset = i * sizeof(VkBool32);
+    featureEntries[i].size = sizeof(VkBool32);
+  }
 
-  VkShaderModule vertTriangle = nullptr;
-  VkShaderModule fragTriangle = nullptr;
-  createShaderModule(Utils::readFile(VERT), &vertTriangle);
-  createShaderModule(Utils::readFile(FRAG), &fragTriangle);
+  VkSpecializationInfo specialization = {};
+  specialization.mapEntryCount = CONSTANT_COUNT;
+  specialization.pMapEntries = featureEntries;
+  specialization.dataSize = sizeof(featureValues);
+  specialization.pData = featureValues;
 
   VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
   vertShaderStageInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertTriangle;
+  vertShaderStageInfo.module = m_sceneVertShader;
   vertShaderStageInfo.pName = "main";
+  vertShaderStageInfo.pSpecializationInfo = &specialization;
 
   VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
   fragShaderStageInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragTriangle;
+  fragShaderStageInfo.module = m_sceneFragShader;
   fragShaderStageInfo.pName = "main";
+  fragShaderStageInfo.pSpecializationInfo = &specialization;
 
   VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo,
                                                     fragShaderStageInfo};
@@ -522,8 +926,8 @@ void Vulkan::createGraphicsPipeline() {
   VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputInfo.vertexBindingDescriptionCount = bindingDescriptions.size();
+  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
   vertexInputInfo.vertexAttributeDescriptionCount =
       attributeDescriptions.size();
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
@@ -534,25 +938,13 @@ void Vulkan::createGraphicsPipeline() {
   inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-  VkViewport viewport = {};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)m_swapchainExtent.width;
-  viewport.height = (float)m_swapchainExtent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  VkRect2D scissor = {};
-  scissor.offset.x = 0;
-  scissor.offset.y = 0;
-  scissor.extent = m_swapchainExtent;
-
+  // Set when the pass begins, resizing keeps the pipelines
   VkPipelineViewportStateCreateInfo viewportState = {};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = nullptr;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = nullptr;
 
   VkPipelineDepthStencilStateCreateInfo depthStencil = {};
   depthStencil.sType =
@@ -573,6 +965,7 @@ void Vulkan::createGraphicsPipeline() {
   rasterizer.rasterizerDiscardEnable = VK_FALSE;
   rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
   rasterizer.lineWidth = 1.0f;
+  // Set per frame instead with dynamic rendering
   rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
   rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
   rasterizer.depthBiasEnable = VK_FALSE;
@@ -614,24 +1007,23 @@ void Vulkan::createGraphicsPipeline() {
   colorBlending.blendConstants[2] = 0.0f;
   colorBlending.blendConstants[3] = 0.0f;
 
-  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
-                                    VK_DYNAMIC_STATE_LINE_WIDTH};
+  std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
+                                               VK_DYNAMIC_STATE_SCISSOR};
+  if (m_dynamicRendering) {
+    dynamicStates.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+  }
 
   VkPipelineDynamicStateCreateInfo dynamicState = {};
   dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = 2;
-  dynamicState.pDynamicStates = dynamicStates;
-
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;
-  pipelineLayoutInfo.pPushConstantRanges = nullptr;
+  dynamicState.dynamicStateCount = dynamicStates.size();
+  dynamicState.pDynamicStates = dynamicStates.data();
 
-  VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr,
-                                  &m_pipelineLayout),
-           "Creating pipeline layout");
+  // Replaces the render pass, only the attachment formats have to match
+  VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &m_sceneColorFormat;
+  renderingInfo.depthAttachmentFormat = findDepthFormat();
 
   VkGraphicsPipelineCreateInfo pipelineInfo = {};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -644,25 +1036,115 @@ void Vulkan::createGraphicsPipeline() {
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pColorBlendState = &colorBlending;
   pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.pNext = m_dynamicRendering ? &renderingInfo : nullptr;
   pipelineInfo.layout = m_pipelineLayout;
   pipelineInfo.renderPass = m_renderPass;
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo,
-                                     nullptr, &m_pipeline),
+  if (pass == SCENE_PASS_PREPASS_COLOR) {
+    // After the pre-pass the depth buffer holds the nearest surfaces, only the
+    // fragments matching them are shaded
+    depthStencil.depthWriteEnable = VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+  } else if (pass == SCENE_PASS_DEPTH_PREPASS) {
+    // No fragment shader
+    vertShaderStageInfo.module = m_depthVertShader;
+    vertShaderStageInfo.pSpecializationInfo = nullptr;
+    colorBlendAttachment.colorWriteMask = 0;
+
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertShaderStageInfo;
+  }
+
+  VkPipeline pipeline;
+  VK_CHECK(vkCreateGraphicsPipelines(m_device, cache, 1, &pipelineInfo, nullptr,
+                                     &pipeline),
            "Creating graphics pipeline");
 
-  vkDestroyShaderModule(m_device, vertTriangle, nullptr);
-  vkDestroyShaderModule(m_device, fragTriangle, nullptr);
+  return pipeline;
+}
+
+std::shared_future<VkPipeline>
+Vulkan::compileScenePipeline(uint32_t features, ScenePass pass) {
+  return m_pipelineCompiler.compile(
+      [this, features, pass](VkPipelineCache cache) {
+        return createScenePipeline(features, pass, cache);
+      });
+}
+
+void Vulkan::createVariantPipelines(uint32_t features) {
+  uint32_t slot = m_colorPipelines.size();
+
+  m_colorPipelines.push_back(m_genericColorPipeline);
+  m_prepassColorPipelines.push_back(m_genericPrepassColorPipeline);
+  m_depthPipelines.push_back(m_depthPrepassPipeline);
+
+  m_pendingPipelines.push_back(
+      {slot, SCENE_PASS_COLOR,
+       compileScenePipeline(features, SCENE_PASS_COLOR)});
+  m_pendingPipelines.push_back(
+      {slot, SCENE_PASS_PREPASS_COLOR,
+       compileScenePipeline(features, SCENE_PASS_PREPASS_COLOR)});
+}
+
+void Vulkan::updatePipelines() {
+  // Compiled variants replace the generic pipelines in their slots, frames
+  // are recorded from scratch so the next one picks them up
+  for (size_t i = 0; i < m_pendingPipelines.size();) {
+    PendingPipeline &pending = m_pendingPipelines[i];
+
+    if (pending.pipeline.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      ++i;
+      continue;
+    }
+
+    std::vector<VkPipeline> &table = pending.pass == SCENE_PASS_COLOR
+                                         ? m_colorPipelines
+                                         : m_prepassColorPipelines;
+    table[pending.slot] = pending.pipeline.get();
+
+    m_pendingPipelines[i] = m_pendingPipelines.back();
+    m_pendingPipelines.pop_back();
+  }
+}
+
+uint32_t Vulkan::variantSlot(uint32_t features) {
+  auto found = m_variantSlots.find(features);
+  if (found != m_variantSlots.end()) {
+    return found->second;
+  }
+
+  uint32_t slot = m_variantFeatures.size();
+  if (slot == 1u << DrawList::PIPELINE_BITS) {
+    printf("ERROR: Too many shader variants\n");
+    exit(EXIT_FAILURE);
+  }
+
+  m_variantSlots[features] = slot;
+  m_variantFeatures.push_back(features);
+  createVariantPipelines(features);
+
+  return slot;
+}
+
+MaterialHandle Vulkan::createMaterial(const Material &material) {
+  m_materials.push_back(material);
+  m_materialSlots.push_back(variantSlot(material.features));
+
+  return m_materials.size() - 1;
 }
 
-void Vulkan::createShaderModule(std::vector<char> code,
+void Vulkan::createShaderModule(const char *name,
                                 VkShaderModule *shaderModule) {
+  const ShaderBinary &binary = Shaders::get(name);
+
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = (uint32_t *)code.data();
+  createInfo.codeSize = binary.size;
+  createInfo.pCode = binary.code;
 
   VK_CHECK(vkCreateShaderModule(m_device, &createInfo, nullptr, shaderModule),
            "Creating shader module");
@@ -694,14 +1176,32 @@ void Vulkan::createCommandPool() {
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex = getGraphicQueue().graphicsFamily;
-  poolInfo.flags = 0;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
   VK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool),
            "Creating command pool");
 }
 
+void Vulkan::createTextureResidency() {
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+
+  if (m_hasMemoryBudget) {
+    getMemoryProperties2 =
+        (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+            m_instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+  }
+
+  m_residency.create(m_physicalDevice, getMemoryProperties2, textureBudget);
+}
+
+void Vulkan::createUploadScheduler() {
+  m_uploads.create(m_device, m_physicalDevice, m_graphicsQueue,
+                   getGraphicQueue().graphicsFamily, STAGING_RING_SIZE,
+                   UPLOAD_FRAME_BUDGET);
+}
+
 void Vulkan::createCommandBuffers() {
-  m_commandBuffers.resize(m_swapchainFramebuffers.size());
+  m_commandBuffers.resize(m_swapchainImages.size());
 
   VkCommandBufferAllocateInfo allocInfo = {};
   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -712,50 +1212,300 @@ void Vulkan::createCommandBuffers() {
   VK_CHECK(
       vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()),
       "Allocating command buffers");
+}
+
+void Vulkan::recordCommandBuffer(uint32_t imageIndex) {
+  VkCommandBuffer commandBuffer = m_commandBuffers[imageIndex];
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = nullptr;
+
+  VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo),
+           "Beginning command buffer");
+
+  if (m_gpuDriven) {
+    recordCulling(commandBuffer);
+  }
+
+  beginScenePass(commandBuffer, imageIndex);
+
+  // Both passes share the layout, descriptor sets bound by the first one stay
+  // bound for the second
+  m_bindCounts = {};
+  BoundState bound;
 
-  for (size_t i = 0; i < m_commandBuffers.size(); ++i) {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;
-    beginInfo.pInheritanceInfo = nullptr;
+  // Draws that don't push their object read it from the object buffer
+  uint32_t pushed = 0;
+  vkCmdPushConstants(commandBuffer, m_pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushed), &pushed);
 
-    VK_CHECK(vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo),
-             "Beginning command buffer");
+  if (depthPrepass) {
+    recordDraws(commandBuffer, m_depthPipelines.data(), bound);
+  }
+
+  recordDraws(commandBuffer,
+              depthPrepass ? m_prepassColorPipelines.data()
+                           : m_colorPipelines.data(),
+              bound);
+
+  endScenePass(commandBuffer, imageIndex);
+
+  if (m_gpuDriven) {
+    recordDepthPyramid(commandBuffer);
+  }
+
+  VK_CHECK(vkEndCommandBuffer(commandBuffer), "Ending command buffer");
+}
 
-    std::vector<VkClearValue> clearValues(2);
-    clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-    clearValues[1].depthStencil = {1.0f, 0};
+void Vulkan::beginScenePass(VkCommandBuffer commandBuffer,
+                            uint32_t imageIndex) {
+  VkClearValue colorClear = {};
+  colorClear.color = {0.0f, 0.0f, 0.0f, 1.0f};
+  VkClearValue depthClear = {};
+  depthClear.depthStencil = {1.0f, 0};
+
+  VkRect2D renderArea = {};
+  renderArea.extent = m_swapchainExtent;
+
+  if (m_dynamicRendering) {
+    // The render pass did these transitions, nothing of the last frame is
+    // kept. The depth buffer was last written by the previous frame and
+    // read by its depth pyramid.
+    std::vector<VkImageMemoryBarrier> barriers(2);
+    barriers[0] = {};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = m_swapchainImages[imageIndex];
+    barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barriers[0].subresourceRange.levelCount = 1;
+    barriers[0].subresourceRange.layerCount = 1;
+
+    barriers[1] = {};
+    barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = m_depthImage;
+    barriers[1].subresourceRange.aspectMask = m_depthAspect;
+    barriers[1].subresourceRange.levelCount = 1;
+    barriers[1].subresourceRange.layerCount = 1;
+
+    // Color waits on the acquire semaphore, which waits at this stage
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         0, 0, nullptr, 0, nullptr, barriers.size(),
+                         barriers.data());
+
+    VkRenderingAttachmentInfoKHR colorAttachment = {};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = m_swapchainImageViews[imageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = colorClear;
+
+    VkRenderingAttachmentInfoKHR depthAttachment = {};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView = m_depthImageView;
+    depthAttachment.imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    // Kept for the depth pyramid of the occlusion culling
+    depthAttachment.storeOp = m_gpuDriven ? VK_ATTACHMENT_STORE_OP_STORE
+                                          : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue = depthClear;
+
+    VkRenderingInfoKHR renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea = renderArea;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    m_cmdBeginRendering(commandBuffer, &renderingInfo);
+
+    m_cmdSetCullMode(commandBuffer, cullBackFaces ? VK_CULL_MODE_BACK_BIT
+                                                  : VK_CULL_MODE_NONE);
+  } else {
+    std::vector<VkClearValue> clearValues = {colorClear, depthClear};
 
     VkRenderPassBeginInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = m_renderPass;
-    renderPassInfo.framebuffer = m_swapchainFramebuffers[i];
-    renderPassInfo.renderArea.offset.x = 0;
-    renderPassInfo.renderArea.offset.y = 0;
-    renderPassInfo.renderArea.extent = m_swapchainExtent;
+    renderPassInfo.framebuffer = m_swapchainFramebuffers[imageIndex];
+    renderPassInfo.renderArea = renderArea;
     renderPassInfo.clearValueCount = clearValues.size();
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo,
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
                          VK_SUBPASS_CONTENTS_INLINE);
+  }
+
+  VkViewport viewport = {};
+  viewport.width = (float)m_swapchainExtent.width;
+  viewport.height = (float)m_swapchainExtent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
+}
+
+void Vulkan::endScenePass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  if (!m_dynamicRendering) {
+    vkCmdEndRenderPass(commandBuffer);
+    return;
+  }
+
+  m_cmdEndRendering(commandBuffer);
+
+  // The depth buffer stays in its attachment layout, the depth pyramid
+  // expects it there
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = m_swapchainImages[imageIndex];
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+void Vulkan::buildDrawList() {
+  glm::vec3 camera = glm::inverse(m_ubo.view)[3];
+
+  // Batches carry their variant's pipeline slot, there is one descriptor set
+  // for now which is slot 0
+  m_drawList.clear();
+  if (m_gpuDriven) {
+    // One indirect call per batch, its objects have no single depth
+    for (uint32_t i = 0; i < m_drawBatches.size(); ++i) {
+      const DrawBatch &batch = m_drawBatches[i];
+      m_drawList.add(DrawList::makeKey(batch.pipeline, 0, batch.mesh, 0.0f),
+                     i);
+    }
+  } else {
+    for (uint32_t i = 0; i < m_cpuDraws.size(); ++i) {
+      const CpuDraw &draw = m_cpuDraws[i];
+      const DrawBatch &batch = m_drawBatches[draw.batch];
+      glm::vec3 position = m_drawObjects[draw.object].model[3];
+
+      m_drawList.add(DrawList::makeKey(batch.pipeline, 0, batch.mesh,
+                                       glm::length(position - camera)),
+                     i);
+    }
+  }
 
-    vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      m_pipeline);
+  m_drawList.sort();
+}
 
-    VkBuffer vertexBuffers[] = {m_vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(m_commandBuffers[i], 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(m_commandBuffers[i], m_indexBuffer, 0,
-                         VK_INDEX_TYPE_UINT32);
-    vkCmdBindDescriptorSets(m_commandBuffers[i],
-                            VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout,
-                            0, 1, &m_descriptorSets[i], 0, nullptr);
+void Vulkan::recordDraws(VkCommandBuffer commandBuffer,
+                         const VkPipeline *pipelines, BoundState &bound) {
+  VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+
+  for (const DrawItem &item : m_drawList.items()) {
+    VkPipeline pipeline = pipelines[DrawList::pipeline(item.key)];
+    if (pipeline != bound.pipeline) {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline);
+      bound.pipeline = pipeline;
+      m_bindCounts.pipelines++;
+    }
 
-    vkCmdDrawIndexed(m_commandBuffers[i], m_rectIndices.size(), 1, 0, 0, 0);
+    // Slot 0 is the frame's uniforms and objects, and the bindless textures
+    // objects index with their texture slot
+    uint32_t descriptorSet = DrawList::descriptorSet(item.key);
+    if (descriptorSet != bound.descriptorSet) {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              m_pipelineLayout, 0, 1, &m_sceneSet, 0,
+                              nullptr);
+      if (m_bindless) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                m_pipelineLayout, 1, 1, &m_bindlessSet, 0,
+                                nullptr);
+      }
+      bound.descriptorSet = descriptorSet;
+      m_bindCounts.descriptorSets++;
+    }
 
-    vkCmdEndRenderPass(m_commandBuffers[i]);
+    uint32_t batchIndex =
+        m_gpuDriven ? item.draw : m_cpuDraws[item.draw].batch;
+    const DrawBatch &batch = m_drawBatches[batchIndex];
+    const Mesh &mesh = getMesh(batch.mesh);
+
+    // Every mesh lives in the geometry pool, bound once per pass. Both
+    // streams stay bound, depth only pipelines don't fetch the attribute one.
+    // Pulling shaders read them through set 0 and only need the indices.
+    if (m_geometryVertexBuffer != bound.vertexBuffer) {
+      if (!m_vertexPulling) {
+        VkBuffer vertexBuffers[] = {m_geometryVertexBuffer,
+                                    m_geometryVertexBuffer};
+        VkDeviceSize offsets[] = {0, m_geometryAttributeOffset};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+      }
+      vkCmdBindIndexBuffer(commandBuffer, m_geometryIndexBuffer, 0,
+                           VK_INDEX_TYPE_UINT32);
+      bound.vertexBuffer = m_geometryVertexBuffer;
+      m_bindCounts.vertexBuffers++;
+    }
 
-    VK_CHECK(vkEndCommandBuffer(m_commandBuffers[i]), "Ending command buffer");
+    // One call per mesh on the GPU path, the culling pass filled in the
+    // commands
+    if (m_hasDrawIndirectCount) {
+      m_drawIndexedIndirectCount(commandBuffer, m_drawCommandBuffer,
+                                 batch.firstCommand * stride,
+                                 m_drawCountBuffer,
+                                 batchIndex * sizeof(uint32_t),
+                                 batch.commandCapacity, stride);
+    } else if (m_gpuDriven) {
+      vkCmdDrawIndexedIndirect(commandBuffer, m_drawCommandBuffer,
+                               batch.firstCommand * stride,
+                               batch.commandCapacity, stride);
+    } else {
+      const CpuDraw &draw = m_cpuDraws[item.draw];
+      if (draw.pushed) {
+        static_assert(sizeof(DrawConstants) ==
+                          triangle_vert_reflection.pushConstantSize,
+                      "DrawConstants doesn't match triangle.vert");
+
+        DrawConstants constants = {};
+        constants.pushed = 1;
+        constants.object = m_drawObjects[draw.object];
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+                           &constants);
+      }
+      vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount,
+                       mesh.firstIndex + draw.firstIndex, mesh.vertexOffset,
+                       draw.firstInstance);
+    }
+    m_bindCounts.draws++;
   }
 }
 
@@ -791,19 +1541,40 @@ void Vulkan::drawFrame() {
     updateSwapchain();
   }
 
+  updateStreaming();
+  updateScene();
+  updatePipelines();
+  m_uploads.update();
+
   uint32_t imageIndex;
   vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX,
                         m_imageAvailableSemaphores[m_currentFrame],
                         VK_NULL_HANDLE, &imageIndex);
 
+  updateUniformBuffer();
+  updateTextureUsage();
+  updateResidency();
+  if (m_gpuDriven) {
+    updateCulling();
+  } else {
+    updateVisibility();
+  }
+  buildDrawList();
+  if (m_texturesDirty) {
+    updateTextureDescriptors();
+  }
+
+  // The frame that last allocated from these pools waited on the same fence
+  m_frameDescriptors[m_currentFrame].reset();
+  m_sceneSet = allocateSceneSet();
+  recordCommandBuffer(imageIndex);
+
   VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
   VkPipelineStageFlags waitStages[] = {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
   VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
 
-  updateUniformBuffer(imageIndex);
-
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
   submitInfo.waitSemaphoreCount = 1;
@@ -856,6 +1627,7 @@ void Vulkan::drawFrame() {
   vkQueueWaitIdle(m_presentQueue);
 
   m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  m_frameCount++;
 }
 
 void Vulkan::updateSwapchain() {
@@ -870,15 +1642,27 @@ void Vulkan::updateSwapchain() {
 
   invalidateSwapchain();
 
+  // Cached sets point at the depth pyramid, the device is idle
+  m_descriptorCache.clear();
+
   createSwapchain();
   createImageView();
-  createRenderPass();
-  createGraphicsPipeline();
+
+  // Viewport and scissor are dynamic, only another surface format invalidates
+  // the pipelines
+  if (m_swapchainImageFormat != m_sceneColorFormat) {
+    destroyGraphicsPipeline();
+    if (!m_dynamicRendering) {
+      createRenderPass();
+    }
+    createGraphicsPipeline();
+  }
+
   createDepthResources();
-  createFrameBuffers();
-  createUniformBuffers();
-  createDescriptorPool();
-  createDescriptorSets();
+  createDepthPyramid();
+  if (!m_dynamicRendering) {
+    createFrameBuffers();
+  }
   createCommandBuffers();
 }
 
@@ -887,44 +1671,6 @@ void Vulkan::frameResizedCB(GLFWwindow *window, int width, int height) {
   app->m_frameResized = true;
 }
 
-void Vulkan::createVertexBuffer() {
-  VkDeviceSize bufferSize = m_triangle.size();
-
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
-
-  void *pData;
-  VK_CHECK(vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &pData),
-           "Mapping vertex memory");
-  memcpy(pData, m_triangle.shader.data(), (size_t)bufferSize);
-  vkUnmapMemory(m_device, stagingBufferMemory);
-
-  createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexMemory);
-  copyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
-  vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-  vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-}
-
-void Vulkan::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
-                        VkDeviceSize size) {
-  // Should replace by a predefined commandPool and commandBuffer
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferCopy copyRegion = {};
-  copyRegion.size = size;
-
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  endSingleTimeCommands(commandBuffer);
-}
-
 void Vulkan::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                           VkMemoryPropertyFlags properties, VkBuffer &buffer,
                           VkDeviceMemory &bufferMemory) {
@@ -952,50 +1698,9 @@ void Vulkan::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
            "Binding memory");
 }
 
-void Vulkan::createIndexBuffer() {
-  VkDeviceSize bufferSize = sizeof(m_rectIndices[0]) * m_rectIndices.size();
-
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
-
-  void *data;
-  vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, m_rectIndices.data(), (size_t)bufferSize);
-  vkUnmapMemory(m_device, stagingBufferMemory);
-
-  createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexMemory);
-
-  copyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
-
-  vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-  vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-}
-
 void Vulkan::createDescriptorSetLayout() {
-  VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  uboLayoutBinding.pImmutableSamplers = nullptr;
-
-  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-  samplerLayoutBinding.binding = 1;
-  samplerLayoutBinding.descriptorType =
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.descriptorCount = 1;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-  samplerLayoutBinding.pImmutableSamplers = nullptr;
-
-  std::vector<VkDescriptorSetLayoutBinding> layouts = {uboLayoutBinding,
-                                                       samplerLayoutBinding};
+  // In bindless mode textures live in their own set
+  std::vector<VkDescriptorSetLayoutBinding> layouts = sceneBindings(0);
 
   VkDescriptorSetLayoutCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1005,171 +1710,247 @@ void Vulkan::createDescriptorSetLayout() {
   VK_CHECK(vkCreateDescriptorSetLayout(m_device, &createInfo, nullptr,
                                        &m_descriptorSetLayout),
            "Creating layout descriptor");
+  m_descriptorCache.addLayout(m_descriptorSetLayout, layouts);
+
+  if (!m_bindless) {
+    return;
+  }
+
+  std::vector<VkDescriptorSetLayoutBinding> textureBindings = sceneBindings(1);
+
+  // Slots are only written once their handle exists and can be rewritten
+  // while a command buffer using the set is pending
+  std::vector<VkDescriptorBindingFlagsEXT> bindingFlags(
+      textureBindings.size(),
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT);
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+  bindingFlagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  bindingFlagsInfo.bindingCount = bindingFlags.size();
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+  VkDescriptorSetLayoutCreateInfo bindlessInfo = {};
+  bindlessInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  bindlessInfo.pNext = &bindingFlagsInfo;
+  bindlessInfo.flags =
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+  bindlessInfo.bindingCount = textureBindings.size();
+  bindlessInfo.pBindings = textureBindings.data();
+
+  VK_CHECK(vkCreateDescriptorSetLayout(m_device, &bindlessInfo, nullptr,
+                                       &m_bindlessSetLayout),
+           "Creating bindless layout descriptor");
 }
 
-void Vulkan::createUniformBuffers() {
-  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+std::vector<VkDescriptorSetLayoutBinding> Vulkan::sceneBindings(uint32_t set) {
+  // The runtime sized texture array of the bindless shader holds every slot
+  return Shaders::setBindings({sceneVertexShader(false),
+                               m_bindless ? BINDLESS_FRAG : FRAG,
+                               sceneVertexShader(true)},
+                              set, m_bindlessCapacity);
+}
 
-  m_uniformBuffers.resize(m_swapchainImages.size());
-  m_uniformMemory.resize(m_swapchainImages.size());
+const char *Vulkan::sceneVertexShader(bool depthOnly) {
+  if (m_vertexPulling) {
+    return depthOnly ? DEPTH_PULL_VERT : PULL_VERT;
+  }
+  return depthOnly ? DEPTH_VERT : VERT;
+}
 
-  for (size_t i = 0; i < m_swapchainImages.size(); ++i) {
+void Vulkan::createBindlessDescriptors() {
+  if (!m_bindless) {
+    return;
+  }
+
+  std::vector<VkDescriptorPoolSize> poolSizes =
+      Shaders::poolSizes(sceneBindings(1), 1);
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  poolInfo.poolSizeCount = poolSizes.size();
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = 1;
+
+  VK_CHECK(
+      vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_bindlessPool),
+      "Creating bindless descriptor pool");
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = m_bindlessPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &m_bindlessSetLayout;
+
+  VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &m_bindlessSet),
+           "Allocating bindless descriptor set");
+}
+
+void Vulkan::createUniformBuffers() {
+  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+
+  m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  m_uniformMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  m_uniformMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                  m_uniformBuffers[i], m_uniformMemory[i]);
+    VK_CHECK(vkMapMemory(m_device, m_uniformMemory[i], 0, bufferSize, 0,
+                         &m_uniformMapped[i]),
+             "Mapping uniform buffer");
   }
 }
 
-void Vulkan::updateUniformBuffer(uint32_t currentImage) {
+void Vulkan::updateUniformBuffer() {
   updateCamera();
 
-  UniformBufferObject ubo = {};
-  ubo.model = glm::translate(
-      glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(1, 0, 0)),
-      glm::vec3(0, 0, -1));
+  UniformBufferObject &ubo = m_ubo;
   ubo.view = glm::lookAt(eye, look_at, up);
   ubo.proj = glm::perspective<float>(
       glm::radians(90.0f),
       m_swapchainExtent.width / (float)m_swapchainExtent.height, 0.1f, 100.0f);
   ubo.proj[1][1] *= -1;
 
-  void *data;
-  vkMapMemory(m_device, m_uniformMemory[currentImage], 0, sizeof(ubo), 0,
-              &data);
-  memcpy(data, &ubo, sizeof(ubo));
-  vkUnmapMemory(m_device, m_uniformMemory[currentImage]);
+  memcpy(m_uniformMapped[m_currentFrame], &ubo, sizeof(ubo));
 }
 
 uint32_t Vulkan::findMemoryType(uint32_t typeFilter,
                                 VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
-    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
-                                    properties) == properties) {
-      return i;
-    }
-  }
-
-  return UINT32_MAX;
+  return Utils::findMemoryType(m_physicalDevice, typeFilter, properties);
 }
 
-void Vulkan::createDescriptorPool() {
-  std::vector<VkDescriptorPoolSize> poolSize(2);
-  poolSize[0] = {};
-  poolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSize[0].descriptorCount = m_swapchainImages.size();
-  poolSize[1] = {};
-  poolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSize[1].descriptorCount = m_swapchainImages.size();
+void Vulkan::createDescriptorAllocators() {
+  DescriptorTemplateFunctions templates;
+  if (m_hasUpdateTemplates) {
+    templates.create = (PFN_vkCreateDescriptorUpdateTemplateKHR)
+        vkGetDeviceProcAddr(m_device, "vkCreateDescriptorUpdateTemplateKHR");
+    templates.destroy = (PFN_vkDestroyDescriptorUpdateTemplateKHR)
+        vkGetDeviceProcAddr(m_device, "vkDestroyDescriptorUpdateTemplateKHR");
+    templates.update = (PFN_vkUpdateDescriptorSetWithTemplateKHR)
+        vkGetDeviceProcAddr(m_device, "vkUpdateDescriptorSetWithTemplateKHR");
+  }
 
-  VkDescriptorPoolCreateInfo createInfo = {};
-  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  createInfo.poolSizeCount = poolSize.size();
-  createInfo.pPoolSizes = poolSize.data();
-  createInfo.maxSets = m_swapchainImages.size();
+  // The scene set is allocated again every frame, the frame's pools are reset
+  // at once when its fence signaled
+  std::vector<VkDescriptorPoolSize> sceneSizes =
+      Shaders::poolSizes(sceneBindings(0), 1);
+  m_frameDescriptors.resize(MAX_FRAMES_IN_FLIGHT);
+  for (DescriptorAllocator &allocator : m_frameDescriptors) {
+    allocator.init(m_device, sceneSizes, FRAME_DESCRIPTOR_SETS);
+  }
 
-  VK_CHECK(
-      vkCreateDescriptorPool(m_device, &createInfo, nullptr, &m_descriptorPool),
-      "Creating descriptor pool");
+  // Sets that never change are the culling and depth pyramid ones, pools
+  // get enough for one of each per set
+  std::vector<VkDescriptorSetLayoutBinding> cachedBindings =
+      Shaders::setBindings({CULL_COMP}, 0);
+  std::vector<VkDescriptorSetLayoutBinding> pyramidBindings =
+      Shaders::setBindings({DEPTH_PYRAMID_COMP}, 0);
+  cachedBindings.insert(cachedBindings.end(), pyramidBindings.begin(),
+                        pyramidBindings.end());
+
+  m_cachedDescriptors.init(m_device, Shaders::poolSizes(cachedBindings, 1),
+                           CACHED_DESCRIPTOR_SETS);
+  m_descriptorCache.init(m_device, &m_cachedDescriptors, templates);
 }
 
-void Vulkan::createDescriptorSets() {
-  std::vector<VkDescriptorSetLayout> layouts(m_swapchainImages.size(),
-                                             m_descriptorSetLayout);
-  VkDescriptorSetAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = m_descriptorPool;
-  allocInfo.descriptorSetCount = m_swapchainImages.size();
-  allocInfo.pSetLayouts = layouts.data();
-
-  m_descriptorSets.resize(m_swapchainImages.size());
-  VK_CHECK(
-      vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()),
-      "Allocating descriptor sets");
-
-  for (size_t i = 0; i < m_swapchainImages.size(); ++i) {
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = m_uniformBuffers[i];
-    bufferInfo.offset = 0;
-    bufferInfo.range = sizeof(UniformBufferObject);
-
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = m_textureImageView;
-    imageInfo.sampler = m_textureSampler;
-
-    std::vector<VkWriteDescriptorSet> descriptorWrite(2);
-    descriptorWrite[0] = {};
-    descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrite[0].dstSet = m_descriptorSets[i];
-    descriptorWrite[0].dstBinding = 0;
-    descriptorWrite[0].dstArrayElement = 0;
-    descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrite[0].descriptorCount = 1;
-    descriptorWrite[0].pBufferInfo = &bufferInfo;
-
-    descriptorWrite[1] = {};
-    descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrite[1].dstSet = m_descriptorSets[i];
-    descriptorWrite[1].dstBinding = 1;
-    descriptorWrite[1].dstArrayElement = 0;
-    descriptorWrite[1].descriptorType =
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrite[1].descriptorCount = 1;
-    descriptorWrite[1].pImageInfo = &imageInfo;
-
-    vkUpdateDescriptorSets(m_device, descriptorWrite.size(),
-                           descriptorWrite.data(), 0, nullptr);
+VkDescriptorSet Vulkan::allocateSceneSet() {
+  VkDescriptorSet set =
+      m_frameDescriptors[m_currentFrame].allocate(m_descriptorSetLayout);
+
+  // The texture is left out in bindless mode, the pool streams without vertex
+  // pulling
+  const std::vector<VkDescriptorSetLayoutBinding> &bindings =
+      m_descriptorCache.bindings(m_descriptorSetLayout);
+  std::vector<DescriptorInfo> infos(bindings.size());
+
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    DescriptorInfo &info = infos[i];
+    switch (bindings[i].binding) {
+    case 0:
+      info.buffer.buffer = m_uniformBuffers[m_currentFrame];
+      info.buffer.offset = 0;
+      info.buffer.range = sizeof(UniformBufferObject);
+      break;
+    case 1:
+      info.image.sampler = m_textureSampler;
+      info.image.imageView = getTexture(m_modelTexture).view;
+      info.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      break;
+    case 2:
+      info.buffer.buffer =
+          m_gpuDriven ? m_objectBuffers[m_objectFront] : m_instanceBuffer;
+      info.buffer.offset = 0;
+      info.buffer.range = VK_WHOLE_SIZE;
+      break;
+    case 3:
+      info.buffer.buffer = m_geometryVertexBuffer;
+      info.buffer.offset = 0;
+      info.buffer.range = m_geometryAttributeOffset;
+      break;
+    case 4:
+      info.buffer.buffer = m_geometryVertexBuffer;
+      info.buffer.offset = m_geometryAttributeOffset;
+      info.buffer.range = VK_WHOLE_SIZE;
+      break;
+    }
   }
-}
 
-void Vulkan::createTextureImage() {
-  int texWidth, texHeight, texChannels;
-  stbi_uc *pixels =
-      stbi_load(TEXT, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
+  m_descriptorCache.write(set, m_descriptorSetLayout, infos);
+  return set;
+}
 
-  if (!pixels) {
-    printf("ERROR: Loading texture");
-    exit(EXIT_FAILURE);
+void Vulkan::updateTextureDescriptors() {
+  if (m_bindless) {
+    updateBindlessDescriptors();
+    return;
   }
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingMemory;
-  createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingMemory);
-
-  void *data;
-  vkMapMemory(m_device, stagingMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, imageSize);
-  vkUnmapMemory(m_device, stagingMemory);
+  // The next scene set is written with the texture as it is now
+  m_dirtyTextures.clear();
+  m_texturesDirty = false;
+}
 
-  stbi_image_free(pixels);
+void Vulkan::updateBindlessDescriptors() {
+  // Handles are the array slots, only the ones that changed are written
+  std::vector<VkDescriptorImageInfo> imageInfos(m_dirtyTextures.size());
+  std::vector<VkWriteDescriptorSet> descriptorWrites(m_dirtyTextures.size());
+
+  for (size_t i = 0; i < m_dirtyTextures.size(); ++i) {
+    imageInfos[i] = {};
+    imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[i].imageView = getTexture(m_dirtyTextures[i]).view;
+    imageInfos[i].sampler = m_textureSampler;
+
+    descriptorWrites[i] = {};
+    descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[i].dstSet = m_bindlessSet;
+    descriptorWrites[i].dstBinding = 0;
+    descriptorWrites[i].dstArrayElement = m_dirtyTextures[i];
+    descriptorWrites[i].descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[i].descriptorCount = 1;
+    descriptorWrites[i].pImageInfo = &imageInfos[i];
+  }
 
-  createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM,
-              VK_IMAGE_TILING_OPTIMAL,
-              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_textureImage,
-              m_textureImageMemory);
+  vkUpdateDescriptorSets(m_device, descriptorWrites.size(),
+                         descriptorWrites.data(), 0, nullptr);
 
-  transitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                        VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  copyBufferToImage(stagingBuffer, m_textureImage, texWidth, texHeight);
-  transitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  m_dirtyTextures.clear();
+  m_texturesDirty = false;
+}
 
-  vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-  vkFreeMemory(m_device, stagingMemory, nullptr);
+void Vulkan::markTextureDirty(TextureHandle handle) {
+  m_dirtyTextures.push_back(handle);
+  m_texturesDirty = true;
 }
 
-void Vulkan::createImage(uint32_t width, uint32_t height, VkFormat format,
+void Vulkan::createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
+                         VkFormat format,
                          VkImageTiling tiling, VkImageUsageFlags usage,
                          VkMemoryPropertyFlags properties, VkImage &image,
                          VkDeviceMemory &imageMemory) {
@@ -1179,7 +1960,7 @@ void Vulkan::createImage(uint32_t width, uint32_t height, VkFormat format,
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.arrayLayers = 1;
   imageInfo.format = format;
   imageInfo.tiling = tiling;
@@ -1304,35 +2085,9 @@ void Vulkan::transitionImageLayout(VkImage image, VkFormat format,
   endSingleTimeCommands(commandBuffer);
 }
 
-void Vulkan::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
-                               uint32_t height) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferImageCopy region = {};
-  region.bufferOffset = 0;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
-  region.imageOffset = {0, 0, 0};
-  region.imageExtent = {width, height, 1};
-
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = 1;
-
-  vkCmdCopyBufferToImage(commandBuffer, buffer, image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-  endSingleTimeCommands(commandBuffer);
-}
-
-void Vulkan::createTextureImageView() {
-  m_textureImageView = createImageView(m_textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                                       VK_IMAGE_ASPECT_COLOR_BIT);
-}
-
 VkImageView Vulkan::createImageView(VkImage image, VkFormat format,
-                                    VkImageAspectFlags aspectFlags) {
+                                    VkImageAspectFlags aspectFlags,
+                                    uint32_t mipLevels) {
   VkImageViewCreateInfo viewInfo = {};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   viewInfo.image = image;
@@ -1340,7 +2095,7 @@ VkImageView Vulkan::createImageView(VkImage image, VkFormat format,
   viewInfo.format = format;
   viewInfo.subresourceRange.aspectMask = aspectFlags;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
 
@@ -1368,7 +2123,7 @@ void Vulkan::createTextureSampler() {
   samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerInfo.mipLodBias = 0.0f;
   samplerInfo.minLod = 0.0f;
-  samplerInfo.maxLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
   VK_CHECK(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_textureSampler),
            "Creating texture sampler");
@@ -1377,13 +2132,23 @@ void Vulkan::createTextureSampler() {
 void Vulkan::createDepthResources() {
   VkFormat depthFormat = findDepthFormat();
 
-  createImage(
-      m_swapchainExtent.width, m_swapchainExtent.height, depthFormat,
-      VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  if (m_gpuDriven) {
+    usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+  }
+
+  createImage(m_swapchainExtent.width, m_swapchainExtent.height, 1,
+              depthFormat, VK_IMAGE_TILING_OPTIMAL, usage,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage,
+              m_depthImageMemory);
+
+  m_depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (hasStencilComponent(depthFormat)) {
+    m_depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
 
   m_depthImageView =
-      createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+      createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
   transitionImageLayout(m_depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 }
@@ -1420,43 +2185,1302 @@ VkFormat Vulkan::findSupportedFormat(const std::vector<VkFormat> &candidates,
   exit(EXIT_FAILURE);
 }
 
-void Vulkan::loadModel() {
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string warn, err;
+void Vulkan::createPlaceholders() {
+  auto cube = std::make_shared<MeshData>();
+  cube->vertices = m_rectangle.shader;
+  cube->indices = m_rectIndices;
+  Lod::build(cube->vertices, cube->indices, cube->meshlets, cube->lods);
+  cube->occluderIndices =
+      Lod::occluder(cube->vertices, cube->indices, cube->lods);
+  Vertices::split(cube->vertices, cube->positions, cube->attributes);
+
+  auto checker = std::make_shared<TextureData>();
+  checker->width = 2;
+  checker->height = 2;
+  checker->pixels = {255, 255, 255, 255, 128, 128, 128, 255,
+                     128, 128, 128, 255, 255, 255, 255, 255};
+  AssetStreamer::generateMips(*checker);
+
+  createMesh(*cube, m_placeholderMesh, 0,
+             [this, cube]() { m_placeholderMesh.resident = true; });
+  createTexture(*checker, 0, m_placeholderTexture, 0,
+                [this, checker]() { m_placeholderTexture.resident = true; });
+}
+
+MeshHandle Vulkan::requestMesh(const char *path) {
+  MeshHandle handle = m_meshes.size();
+  m_meshes.push_back({});
+  m_streamer.request(AssetType::Mesh, handle, path);
+
+  return handle;
+}
+
+TextureHandle Vulkan::requestTexture(const char *path) {
+  TextureHandle handle = m_textures.size();
+  if (m_bindless && handle >= m_bindlessCapacity) {
+    printf("ERROR: Bindless texture array is full\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Draws the placeholder until the texture is uploaded
+  markTextureDirty(handle);
+  m_textures.push_back({});
+  m_textures[handle].streaming = true;
+  m_textureSources.push_back(nullptr);
+  m_streamer.request(AssetType::Texture, handle, path);
+
+  return handle;
+}
+
+void Vulkan::updateStreaming() {
+  LoadedAsset asset;
+
+  while (m_streamer.poll(asset)) {
+    // Failed assets keep drawing their placeholder
+    if (asset.failed) {
+      if (asset.type == AssetType::Texture) {
+        m_textures[asset.handle].streaming = false;
+      }
+      continue;
+    }
+
+    // The decoded data lives until the last upload touching it completed
+    auto loaded = std::make_shared<LoadedAsset>(std::move(asset));
+    uint32_t handle = loaded->handle;
+
+    switch (loaded->type) {
+    case AssetType::Mesh:
+      createMesh(loaded->mesh, m_meshes[handle], 1,
+                 [this, handle, loaded]() {
+                   m_meshes[handle].resident = true;
+                   m_bvhDirty = true;
+                 });
+      break;
+    case AssetType::Texture:
+      // The full chain stays in system memory, higher levels are uploaded on
+      // demand and evicted textures come back without decoding again
+      m_textureSources[handle] =
+          std::make_shared<TextureData>(std::move(loaded->texture));
+      streamTexture(handle);
+      break;
+    }
+  }
+}
+
+void Vulkan::createGeometryPool() {
+  // Sized once, meshes get ranges of it and the allocation count stays the
+  // same however much content is loaded
+  m_geometryAttributeOffset = MAX_GEOMETRY_VERTICES * sizeof(VertexPosition);
+  createBuffer(m_geometryAttributeOffset +
+                   MAX_GEOMETRY_VERTICES * sizeof(VertexAttributes),
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_geometryVertexBuffer,
+               m_geometryVertexMemory);
+  createBuffer(MAX_GEOMETRY_INDICES * sizeof(uint32_t),
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_geometryIndexBuffer,
+               m_geometryIndexMemory);
+
+  m_geometryVertices.init(MAX_GEOMETRY_VERTICES);
+  m_geometryIndices.init(MAX_GEOMETRY_INDICES);
+}
+
+void Vulkan::createMesh(const MeshData &data, Mesh &mesh, uint32_t priority,
+                        std::function<void()> completed) {
+  // Both streams of a vertex share its index, one range covers them
+  mesh.vertexCount = data.positions.size();
+  mesh.indexCount = data.indices.size();
+  mesh.vertexOffset = m_geometryVertices.allocate(mesh.vertexCount);
+  mesh.firstIndex = m_geometryIndices.allocate(mesh.indexCount);
+  if (mesh.vertexOffset == RangeAllocator::INVALID ||
+      mesh.firstIndex == RangeAllocator::INVALID) {
+    printf("ERROR: Geometry pool is full\n");
+    exit(EXIT_FAILURE);
+  }
+
+  VkDeviceSize positionSize = sizeof(data.positions[0]) * mesh.vertexCount;
+  VkDeviceSize attributeSize = sizeof(data.attributes[0]) * mesh.vertexCount;
+  VkDeviceSize indexSize = sizeof(data.indices[0]) * mesh.indexCount;
+
+  mesh.meshlets = data.meshlets;
+  mesh.lods = data.lods;
+  mesh.resident = false;
+
+  glm::vec3 minimum = data.vertices[0].pos;
+  glm::vec3 maximum = data.vertices[0].pos;
+  for (const Vertex &vertex : data.vertices) {
+    minimum = glm::min(minimum, glm::vec3(vertex.pos));
+    maximum = glm::max(maximum, glm::vec3(vertex.pos));
+  }
+
+  glm::vec3 center = (minimum + maximum) * 0.5f;
+  float radius = 0.0f;
+  for (const Vertex &vertex : data.vertices) {
+    radius = std::max(radius, glm::length(glm::vec3(vertex.pos) - center));
+  }
+  mesh.bounds = glm::vec4(center, radius);
+
+  // The CPU path rasterizes big objects as occluders. The LOD levels can
+  // stick out of the full mesh, the occluder stays inside it so nothing
+  // visible is culled.
+  if (!m_gpuDriven) {
+    std::unordered_map<uint32_t, uint32_t> compacted;
+
+    mesh.occluderPositions.clear();
+    mesh.occluderIndices.clear();
+    for (uint32_t index : data.occluderIndices) {
+      auto inserted = compacted.emplace(index, mesh.occluderPositions.size());
+      if (inserted.second) {
+        mesh.occluderPositions.push_back(data.vertices[index].pos);
+      }
+      mesh.occluderIndices.push_back(inserted.first->second);
+    }
+  }
+
+  // Meshlets are never freed, the table only grows
+  if (m_gpuDriven) {
+    if (m_meshletCount + data.meshlets.size() > MAX_MESHLETS) {
+      printf("ERROR: Meshlet buffer is full\n");
+      exit(EXIT_FAILURE);
+    }
+
+    mesh.firstMeshlet = m_meshletCount;
+    m_meshletCount += data.meshlets.size();
+
+    m_uploads.uploadBuffer(data.meshlets.data(),
+                           data.meshlets.size() * sizeof(Meshlet),
+                           m_meshletBuffer,
+                           mesh.firstMeshlet * sizeof(Meshlet), priority);
+  }
+
+  // Same priority uploads finish in order, the index upload completes last
+  m_uploads.uploadBuffer(data.positions.data(), positionSize,
+                         m_geometryVertexBuffer,
+                         mesh.vertexOffset * sizeof(VertexPosition), priority);
+  m_uploads.uploadBuffer(data.attributes.data(), attributeSize,
+                         m_geometryVertexBuffer,
+                         m_geometryAttributeOffset +
+                             mesh.vertexOffset * sizeof(VertexAttributes),
+                         priority);
+  m_uploads.uploadBuffer(data.indices.data(), indexSize, m_geometryIndexBuffer,
+                         mesh.firstIndex * sizeof(uint32_t), priority,
+                         std::move(completed));
+}
+
+void Vulkan::createTexture(const TextureData &data, uint32_t baseMipLevel,
+                           Texture &texture, uint32_t priority,
+                           std::function<void()> completed) {
+  allocateTexture(data, baseMipLevel, texture);
+
+  // Same priority uploads finish in order, the last level completes last
+  for (uint32_t level = baseMipLevel; level < data.mipLevels(); ++level) {
+    bool last = level + 1 == data.mipLevels();
+
+    m_uploads.uploadImage(data.pixels.data() + data.mipOffsets[level],
+                          texture.image, data.mipWidth(level),
+                          data.mipHeight(level), 4, level - baseMipLevel,
+                          priority, last ? std::move(completed) : nullptr);
+  }
+}
+
+void Vulkan::allocateTexture(const TextureData &data, uint32_t baseMipLevel,
+                             Texture &texture) {
+  uint32_t mipLevels = data.mipLevels() - baseMipLevel;
+
+  // Only the resident levels get memory, level 0 of the image is baseMipLevel
+  // of the chain. Transfer source so levels can be copied into a resized image
+  createImage(data.mipWidth(baseMipLevel), data.mipHeight(baseMipLevel),
+              mipLevels, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                  VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image,
+              texture.memory);
+
+  VkMemoryRequirements memReqs;
+  vkGetImageMemoryRequirements(m_device, texture.image, &memReqs);
+
+  texture.view = createImageView(texture.image, VK_FORMAT_R8G8B8A8_UNORM,
+                                 VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+  texture.width = data.width;
+  texture.height = data.height;
+  texture.baseMipLevel = baseMipLevel;
+  texture.mipLevels = mipLevels;
+  texture.fullMipLevels = data.mipLevels();
+  texture.size = memReqs.size;
+  texture.resident = false;
+}
+
+uint32_t Vulkan::tailMipLevel(const TextureData &data) {
+  uint32_t level = 0;
+  while (level + 1 < data.mipLevels() &&
+         std::max(data.mipWidth(level), data.mipHeight(level)) >
+             STREAMING_TAIL_SIZE) {
+    level++;
+  }
+
+  return level;
+}
+
+uint32_t Vulkan::desiredMipLevel(const Mesh &mesh, const glm::mat4 &transform,
+                                 const Texture &texture) {
+  glm::mat4 modelView = m_ubo.view * transform;
+  glm::vec4 center = modelView * glm::vec4(glm::vec3(mesh.bounds), 1.0f);
+
+  float scale = std::max(glm::length(glm::vec3(transform[0])),
+                         std::max(glm::length(glm::vec3(transform[1])),
+                                  glm::length(glm::vec3(transform[2]))));
+  float radius = mesh.bounds.w * scale;
+  float distance = glm::length(glm::vec3(center)) - radius;
+
+  // Inside the bounds, the surface can be arbitrarily close
+  if (distance <= 0.0f) {
+    return 0;
+  }
+
+  // Assumes the UVs cover the texture once across the object
+  float pixels = radius * std::abs(m_ubo.proj[1][1]) *
+                 m_swapchainExtent.height / distance;
+  float texels = (float)std::max(texture.width, texture.height);
+
+  if (pixels >= texels) {
+    return 0;
+  }
+
+  uint32_t level = (uint32_t)std::floor(std::log2(texels / pixels));
+  return std::min(level, texture.fullMipLevels - 1);
+}
+
+void Vulkan::updateTextureUsage() {
+  // The closest object using a texture decides how much of it is needed
+  std::vector<uint32_t> desired(m_textures.size(), UINT32_MAX);
+  for (const SceneObject &object : m_objects) {
+    if (!(m_materials[object.material].features & MATERIAL_TEXTURE)) {
+      continue;
+    }
+
+    uint32_t level = desiredMipLevel(getMesh(object.mesh), object.transform,
+                                     m_textures[object.texture]);
+    desired[object.texture] = std::min(desired[object.texture], level);
+  }
+
+  for (TextureHandle handle = 0; handle < m_textures.size(); ++handle) {
+    if (desired[handle] != UINT32_MAX) {
+      useTexture(handle, desired[handle]);
+    }
+  }
+}
+
+void Vulkan::useTexture(TextureHandle handle, uint32_t desiredMipLevel) {
+  Texture &texture = m_textures[handle];
+
+  if (texture.resident) {
+    m_residency.touch(handle, m_frameCount);
+  }
+
+  if (texture.streaming || m_textureSources[handle] == nullptr) {
+    return;
+  }
+
+  const TextureData &source = *m_textureSources[handle];
+
+  // Evicted earlier, start over from the tail
+  if (!texture.resident) {
+    streamTexture(handle);
+    return;
+  }
+
+  // One level at a time so detail fills in progressively, within the budget
+  if (desiredMipLevel < texture.baseMipLevel) {
+    uint32_t level = texture.baseMipLevel - 1;
+    VkDeviceSize bytes =
+        (VkDeviceSize)source.mipWidth(level) * source.mipHeight(level) * 4;
+
+    // The old image stays alive next to the new chain until swapTexture
+    VkDeviceSize grown = texture.size + bytes;
+    if (m_residency.usage() + grown <= m_residency.effectiveBudget()) {
+      resizeTexture(handle, level);
+    }
+  } else if (desiredMipLevel > texture.baseMipLevel + 1) {
+    resizeTexture(handle, desiredMipLevel - 1);
+  }
+}
+
+void Vulkan::streamTexture(TextureHandle handle) {
+  std::shared_ptr<TextureData> source = m_textureSources[handle];
+  auto incoming = std::make_shared<Texture>();
+
+  m_textures[handle].streaming = true;
+
+  createTexture(*source, tailMipLevel(*source), *incoming, 0,
+                [this, handle, source, incoming]() {
+                  swapTexture(handle, *incoming);
+                });
+}
+
+void Vulkan::swapTexture(TextureHandle handle, const Texture &incoming) {
+  // Runs at the start of a frame, the previous one is idle
+  destroyTexture(m_textures[handle]);
+
+  Texture &texture = m_textures[handle];
+  texture = incoming;
+  texture.resident = true;
+  texture.streaming = false;
+
+  m_residency.track(handle, texture.size, texture.mipLevels, m_frameCount);
+  markTextureDirty(handle);
+}
+
+void Vulkan::updateResidency() {
+  std::vector<ResidencyAction> actions =
+      m_residency.collect(m_frameCount, MAX_FRAMES_IN_FLIGHT + 1);
+
+  for (const ResidencyAction &action : actions) {
+    Texture &texture = m_textures[action.handle];
+
+    if (texture.streaming) {
+      continue;
+    }
+
+    if (action.keepMipLevels == 0) {
+      destroyTexture(texture);
+      m_residency.untrack(action.handle);
+      markTextureDirty(action.handle);
+    } else {
+      resizeTexture(action.handle, texture.fullMipLevels - action.keepMipLevels);
+    }
+  }
+}
+
+static void recordMipCopy(VkCommandBuffer commandBuffer, VkImage src,
+                          uint32_t srcBaseMipLevel, VkImage dst,
+                          uint32_t dstBaseMipLevel, uint32_t firstLevel,
+                          uint32_t levelCount, const TextureData &source) {
+  std::vector<VkImageMemoryBarrier> barriers(2);
+  barriers[0] = {};
+  barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].image = src;
+  barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT,
+                                  firstLevel - srcBaseMipLevel, levelCount, 0,
+                                  1};
+  barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  barriers[1] = barriers[0];
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[1].image = dst;
+  barriers[1].subresourceRange.baseMipLevel = firstLevel - dstBaseMipLevel;
+  barriers[1].srcAccessMask = 0;
+  barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, barriers.size(), barriers.data());
+
+  std::vector<VkImageCopy> regions(levelCount);
+  for (uint32_t i = 0; i < levelCount; ++i) {
+    uint32_t level = firstLevel + i;
+
+    regions[i] = {};
+    regions[i].srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT,
+                                 level - srcBaseMipLevel, 0, 1};
+    regions[i].dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT,
+                                 level - dstBaseMipLevel, 0, 1};
+    regions[i].extent = {source.mipWidth(level), source.mipHeight(level), 1};
+  }
+
+  vkCmdCopyImage(commandBuffer, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(),
+                 regions.data());
+
+  // The old image keeps being sampled until the swap
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, barriers.size(), barriers.data());
+}
+
+void Vulkan::resizeTexture(TextureHandle handle, uint32_t baseMipLevel) {
+  Texture &texture = m_textures[handle];
+  std::shared_ptr<TextureData> source = m_textureSources[handle];
+  auto incoming = std::make_shared<Texture>();
+
+  allocateTexture(*source, baseMipLevel, *incoming);
+  texture.streaming = true;
+
+  // Levels both images hold are copied on the GPU, the rest comes from source
+  VkImage src = texture.image;
+  VkImage dst = incoming->image;
+  uint32_t srcBaseMipLevel = texture.baseMipLevel;
+  uint32_t firstShared = std::max(baseMipLevel, texture.baseMipLevel);
+  uint32_t priority = 1;
+
+  std::function<void()> completed = [this, handle, source, incoming]() {
+    swapTexture(handle, *incoming);
+  };
+
+  UploadRequest copy;
+  copy.priority = priority;
+  copy.record = [src, dst, srcBaseMipLevel, baseMipLevel, firstShared,
+                 source](VkCommandBuffer cmd, VkBuffer, VkDeviceSize,
+                         VkDeviceSize, VkDeviceSize) {
+    recordMipCopy(cmd, src, srcBaseMipLevel, dst, baseMipLevel, firstShared,
+                  source->mipLevels() - firstShared, *source);
+  };
+
+  if (baseMipLevel >= texture.baseMipLevel) {
+    copy.completed = std::move(completed);
+    m_uploads.enqueue(std::move(copy));
+    return;
+  }
+
+  m_uploads.enqueue(std::move(copy));
+
+  // Same priority requests finish in order, the last new level completes last
+  for (uint32_t level = baseMipLevel; level < texture.baseMipLevel; ++level) {
+    bool last = level + 1 == texture.baseMipLevel;
+
+    m_uploads.uploadImage(source->pixels.data() + source->mipOffsets[level],
+                          dst, source->mipWidth(level),
+                          source->mipHeight(level), 4, level - baseMipLevel,
+                          priority, last ? std::move(completed) : nullptr);
+  }
+}
+
+void Vulkan::createSceneBuffers() {
+  for (uint32_t i = 0; i < 2; ++i) {
+    createBuffer(MAX_OBJECTS * sizeof(ObjectData),
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_objectBuffers[i],
+                 m_objectMemory[i]);
+  }
+
+  // The CPU path draws from a copy of the visible objects, grouped by draw
+  if (!m_gpuDriven) {
+    createBuffer(MAX_OBJECTS * sizeof(ObjectData),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 m_instanceBuffer, m_instanceMemory);
+    VK_CHECK(vkMapMemory(m_device, m_instanceMemory, 0, VK_WHOLE_SIZE, 0,
+                         &m_instanceMapped),
+             "Mapping instance buffer");
+    return;
+  }
+
+  createBuffer(MAX_MESHLETS * sizeof(Meshlet),
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_meshletBuffer,
+               m_meshletMemory);
+  createBuffer(MAX_DRAW_COMMANDS * sizeof(VkDrawIndexedIndirectCommand),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_drawCommandBuffer,
+               m_drawCommandMemory);
+  createBuffer(MAX_DRAW_BATCHES * sizeof(uint32_t),
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_drawCountBuffer,
+               m_drawCountMemory);
+
+  // Rewritten every frame, the previous frame is idle by then
+  createBuffer(sizeof(CullData) + MAX_DRAW_BATCHES * sizeof(BatchData),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               m_cullBuffer, m_cullMemory);
+  VK_CHECK(vkMapMemory(m_device, m_cullMemory, 0, VK_WHOLE_SIZE, 0,
+                       &m_cullMapped),
+           "Mapping cull buffer");
+
+  // Read back once the frame that wrote it is idle
+  createBuffer(sizeof(CullingStats),
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               m_cullStatsBuffer, m_cullStatsMemory);
+  VK_CHECK(vkMapMemory(m_device, m_cullStatsMemory, 0, VK_WHOLE_SIZE, 0,
+                       &m_cullStatsMapped),
+           "Mapping cull stats buffer");
+  memset(m_cullStatsMapped, 0, sizeof(CullingStats));
+}
+
+void Vulkan::createCullingPipeline() {
+  if (!m_gpuDriven) {
+    return;
+  }
+
+  // Storage buffers first, the depth pyramid comes last
+  std::vector<VkDescriptorSetLayoutBinding> bindings =
+      Shaders::setBindings({CULL_COMP}, 0);
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = bindings.size();
+  layoutInfo.pBindings = bindings.data();
+
+  VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr,
+                                       &m_cullSetLayout),
+           "Creating cull layout descriptor");
+
+  // The set is looked up along with the depth pyramid it reads
+  m_descriptorCache.addLayout(m_cullSetLayout, bindings);
+
+  // The batch index
+  std::vector<VkPushConstantRange> batchRanges =
+      Shaders::pushConstantRanges({CULL_COMP});
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &m_cullSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = batchRanges.size();
+  pipelineLayoutInfo.pPushConstantRanges = batchRanges.data();
+
+  VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr,
+                                  &m_cullPipelineLayout),
+           "Creating cull pipeline layout");
+
+  VkShaderModule cullModule = nullptr;
+  createShaderModule(CULL_COMP, &cullModule);
 
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, OBJ)) {
-    printf("ERROR: %s", err.c_str());
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = cullModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = m_cullPipelineLayout;
+
+  VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo,
+                                    nullptr, &m_cullPipeline),
+           "Creating cull pipeline");
+
+  vkDestroyShaderModule(m_device, cullModule, nullptr);
+}
+
+void Vulkan::addObject(MeshHandle mesh, TextureHandle texture,
+                       MaterialHandle material, const glm::mat4 &transform) {
+  if (m_objects.size() >= MAX_OBJECTS) {
+    printf("ERROR: Too many scene objects\n");
     exit(EXIT_FAILURE);
   }
 
-  std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+  m_objects.push_back({mesh, texture, material, transform});
+  m_sceneDirty = true;
+}
+
+void Vulkan::updateScene() {
+  // The back buffer is written until the pending upload completes, changes
+  // wait for it
+  if (!m_sceneDirty || m_objectUploadPending) {
+    return;
+  }
+
+  m_sceneDirty = false;
+
+  // Objects sharing a mesh and shader variant are laid out next to each other
+  // so each batch is one contiguous range of indirect commands
+  std::vector<uint32_t> order(m_objects.size());
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    const SceneObject &first = m_objects[a];
+    const SceneObject &second = m_objects[b];
+
+    if (first.mesh != second.mesh) {
+      return first.mesh < second.mesh;
+    }
+    return m_materialSlots[first.material] < m_materialSlots[second.material];
+  });
+
+  auto objects = std::make_shared<std::vector<ObjectData>>(order.size());
+  auto batches = std::make_shared<std::vector<DrawBatch>>();
+
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    const SceneObject &object = m_objects[order[i]];
+    uint32_t pipeline = m_materialSlots[object.material];
+
+    if (batches->empty() || batches->back().mesh != object.mesh ||
+        batches->back().pipeline != pipeline) {
+      if (batches->size() == MAX_DRAW_BATCHES) {
+        printf("ERROR: Too many meshes in the scene\n");
+        exit(EXIT_FAILURE);
+      }
+
+      batches->push_back({object.mesh, i, 0, 0, 0, pipeline});
+    }
+
+    batches->back().objectCount++;
+
+    ObjectData &data = (*objects)[i];
+    data = {};
+    data.model = object.transform;
+    data.batch = batches->size() - 1;
+    data.textureIndex = object.texture;
+    data.color = glm::packUnorm4x8(m_materials[object.material].color);
+    data.features = m_materials[object.material].features;
+  }
+
+  // The upload can take several frames, they keep drawing the previous
+  // layout from the front buffer. Frames are waited on before the next one
+  // is recorded, nothing reads the back buffer by the time it's written.
+  uint32_t back = 1 - m_objectFront;
+  m_objectUploadPending = true;
+  m_uploads.uploadBuffer(
+      objects->data(), objects->size() * sizeof(ObjectData),
+      m_objectBuffers[back], 0, 2, [this, objects, batches, back]() {
+        m_drawBatches = std::move(*batches);
+        m_drawObjects = std::move(*objects);
+        m_drawObjectCount = m_drawObjects.size();
+        m_bvhDirty = true;
+
+        m_objectFront = back;
+        m_objectUploadPending = false;
+        if (m_gpuDriven) {
+          updateCullSet();
+        }
+      });
+}
+
+void Vulkan::updateVisibility() {
+  // Bounds change when meshes finish streaming, the BVH is rebuilt then
+  if (m_bvhDirty) {
+    std::vector<glm::vec3> mins(m_drawObjects.size());
+    std::vector<glm::vec3> maxs(m_drawObjects.size());
+
+    for (uint32_t i = 0; i < m_drawObjects.size(); ++i) {
+      const ObjectData &object = m_drawObjects[i];
+      const Mesh &mesh = getMesh(m_drawBatches[object.batch].mesh);
+
+      glm::vec3 center =
+          glm::vec3(object.model * glm::vec4(glm::vec3(mesh.bounds), 1.0f));
+      float scale = std::max(glm::length(glm::vec3(object.model[0])),
+                             std::max(glm::length(glm::vec3(object.model[1])),
+                                      glm::length(glm::vec3(object.model[2]))));
+      glm::vec3 extent(mesh.bounds.w * scale);
+
+      mins[i] = center - extent;
+      maxs[i] = center + extent;
+    }
+
+    m_bvh.build(mins, maxs);
+    m_bvhDirty = false;
+  }
+
+  Frustum frustum = Frustum::fromMatrix(m_ubo.proj * m_ubo.view);
+  glm::vec3 camera = glm::inverse(m_ubo.view)[3];
+  bool backFaces = cullBackFaces || !m_dynamicRendering;
 
-  for (tinyobj::shape_t &shape : shapes) {
-    for (tinyobj::index_t &index : shape.mesh.indices) {
-      Vertex vertex = {};
+  m_visibleObjects.clear();
+  m_bvh.cull(frustum, m_visibleObjects);
 
-      vertex.pos = {attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]};
+  // Sorted, the visible objects of each batch form one run
+  std::sort(m_visibleObjects.begin(), m_visibleObjects.end());
 
-      vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
-                         1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+  if (softwareOcclusion) {
+    updateSoftwareOcclusion(camera);
+  }
+
+  float pixelsPerUnit =
+      std::abs(m_ubo.proj[1][1]) * m_swapchainExtent.height * 0.5f;
+
+  ObjectData *instances = (ObjectData *)m_instanceMapped;
+  uint32_t instanceCount = 0;
+
+  m_cpuDraws.clear();
+  m_instanceKeys.clear();
+  for (uint32_t objectIndex : m_visibleObjects) {
+    const ObjectData &object = m_drawObjects[objectIndex];
+    const Mesh &mesh = getMesh(m_drawBatches[object.batch].mesh);
+
+    float scale = std::max(glm::length(glm::vec3(object.model[0])),
+                           std::max(glm::length(glm::vec3(object.model[1])),
+                                    glm::length(glm::vec3(object.model[2]))));
+
+    glm::vec3 center =
+        glm::vec3(object.model * glm::vec4(glm::vec3(mesh.bounds), 1.0f));
+    float distance = glm::length(center - camera) - mesh.bounds.w * scale;
+    uint32_t level = Lod::select(mesh.lods, scale, distance, pixelsPerUnit,
+                                 lodThreshold);
 
-      vertex.color = {1.0f, 1.0f, 1.0f};
+    if (instancing) {
+      m_instanceKeys.push_back((uint64_t)object.batch << 40 |
+                               (uint64_t)level << 32 | objectIndex);
+      continue;
+    }
+
+    // Neighbouring visible meshlets are contiguous indices, one draw covers
+    // them. The draws push the object, it isn't copied to the instances.
+    const MeshLod &lod = mesh.lods[level];
+    bool merging = false;
+    for (uint32_t i = 0; i < lod.meshletCount; ++i) {
+      const Meshlet &meshlet = mesh.meshlets[lod.firstMeshlet + i];
+
+      if (!Meshlets::visible(meshlet, object.model, scale, frustum, camera,
+                             backFaces)) {
+        merging = false;
+        continue;
+      }
 
-      if (uniqueVertices.count(vertex) == 0) {
-        uniqueVertices[vertex] =
-            static_cast<uint32_t>(m_triangle.shader.size());
-        m_triangle.shader.push_back(vertex);
+      if (merging) {
+        m_cpuDraws.back().indexCount += meshlet.indexCount;
+      } else {
+        m_cpuDraws.push_back({object.batch, 0, 1, meshlet.firstIndex,
+                              meshlet.indexCount, objectIndex, true});
+        merging = true;
       }
+    }
+  }
+
+  if (!instancing) {
+    return;
+  }
+
+  // Sorted by batch then level, every run of keys becomes one instanced draw
+  std::sort(m_instanceKeys.begin(), m_instanceKeys.end());
+
+  for (uint64_t key : m_instanceKeys) {
+    uint32_t batch = key >> 40;
+    uint32_t level = (key >> 32) & 0xFF;
+    const MeshLod &lod = getMesh(m_drawBatches[batch].mesh).lods[level];
+
+    instances[instanceCount] = m_drawObjects[(uint32_t)key];
+
+    if (!m_cpuDraws.empty() && m_cpuDraws.back().batch == batch &&
+        m_cpuDraws.back().firstIndex == lod.firstIndex) {
+      m_cpuDraws.back().instanceCount++;
+    } else {
+      m_cpuDraws.push_back({batch, instanceCount, 1, lod.firstIndex,
+                            lod.indexCount, (uint32_t)key, false});
+    }
+
+    instanceCount++;
+  }
+}
+
+void Vulkan::updateSoftwareOcclusion(const glm::vec3 &camera) {
+  // Scene objects are stored in model space, the test uses their sphere's box
+  std::vector<glm::vec4> spheres(m_visibleObjects.size());
+  std::vector<std::pair<float, uint32_t>> occluders;
+
+  for (uint32_t i = 0; i < m_visibleObjects.size(); ++i) {
+    const ObjectData &object = m_drawObjects[m_visibleObjects[i]];
+    const Mesh &mesh = getMesh(m_drawBatches[object.batch].mesh);
+
+    float scale = std::max(glm::length(glm::vec3(object.model[0])),
+                           std::max(glm::length(glm::vec3(object.model[1])),
+                                    glm::length(glm::vec3(object.model[2]))));
+    glm::vec3 center =
+        glm::vec3(object.model * glm::vec4(glm::vec3(mesh.bounds), 1.0f));
+    spheres[i] = glm::vec4(center, mesh.bounds.w * scale);
+
+    float distance = std::max(glm::length(center - camera), 1e-3f);
+    float size = spheres[i].w / distance;
+    if (size >= MIN_OCCLUDER_SIZE && !mesh.occluderIndices.empty()) {
+      occluders.push_back({size, i});
+    }
+  }
+
+  uint32_t occluderCount =
+      std::min((uint32_t)occluders.size(), MAX_OCCLUDERS);
+  std::partial_sort(occluders.begin(), occluders.begin() + occluderCount,
+                    occluders.end(),
+                    [](const std::pair<float, uint32_t> &a,
+                       const std::pair<float, uint32_t> &b) {
+                      return a.first > b.first;
+                    });
+
+  m_occlusion.begin(m_ubo.proj * m_ubo.view);
+  std::vector<bool> occluder(m_visibleObjects.size(), false);
+  for (uint32_t i = 0; i < occluderCount; ++i) {
+    uint32_t visible = occluders[i].second;
+    const ObjectData &object = m_drawObjects[m_visibleObjects[visible]];
+    const Mesh &mesh = getMesh(m_drawBatches[object.batch].mesh);
+
+    m_occlusion.addOccluder(mesh.occluderPositions, mesh.occluderIndices,
+                            object.model);
+    occluder[visible] = true;
+  }
+  m_occlusion.render();
+
+  // Occluders would hide themselves behind their own front faces
+  size_t write = 0;
+  for (uint32_t i = 0; i < m_visibleObjects.size(); ++i) {
+    glm::vec3 center(spheres[i]);
+    glm::vec3 extent(spheres[i].w);
+
+    if (occluder[i] || m_occlusion.visible(center - extent, center + extent)) {
+      m_visibleObjects[write++] = m_visibleObjects[i];
+    }
+  }
+
+  m_cullingStats = {};
+  m_cullingStats.testedObjects = m_visibleObjects.size();
+  m_cullingStats.occludedObjects = m_visibleObjects.size() - write;
+  m_visibleObjects.resize(write);
+}
+
+void Vulkan::updateCulling() {
+  CullData *cull = (CullData *)m_cullMapped;
+  BatchData *batches = (BatchData *)(cull + 1);
+
+  // The previous frame is idle, its counters are final
+  m_cullingStats = *(CullingStats *)m_cullStatsMapped;
 
-      m_rectIndices.push_back(uniqueVertices[vertex]);
+  Frustum frustum = Frustum::fromMatrix(m_ubo.proj * m_ubo.view);
+  for (uint32_t i = 0; i < 6; ++i) {
+    cull->planes[i] = frustum.planes[i];
+  }
+
+  cull->camera = glm::inverse(m_ubo.view)[3];
+  cull->objectCount = m_drawObjectCount;
+  cull->compact = m_hasDrawIndirectCount;
+  cull->pixelsPerUnit =
+      std::abs(m_ubo.proj[1][1]) * m_swapchainExtent.height * 0.5f;
+  cull->lodThreshold = lodThreshold;
+  cull->occlusionViewProj = m_occlusionViewProj;
+  cull->pyramidWidth = m_depthPyramidWidth;
+  cull->pyramidHeight = m_depthPyramidHeight;
+  cull->occlusion = occlusionCulling && m_depthPyramidValid;
+  // Without a dynamic cull mode the pipelines always cull back faces
+  cull->backFaces = cullBackFaces || !m_dynamicRendering;
+
+  // Objects get a command slot per meshlet of their largest level, whichever
+  // level the shader picks. Meshes still streaming are culled and drawn as the
+  // placeholder.
+  uint32_t firstCommand = 0;
+  for (uint32_t i = 0; i < m_drawBatches.size(); ++i) {
+    DrawBatch &batch = m_drawBatches[i];
+    const Mesh &mesh = getMesh(batch.mesh);
+
+    uint32_t meshletCount = 0;
+    for (const MeshLod &lod : mesh.lods) {
+      meshletCount = std::max(meshletCount, lod.meshletCount);
+    }
+
+    // The shader drops commands past the capacity, objects would vanish
+    uint64_t commands = (uint64_t)batch.objectCount * meshletCount;
+    if (firstCommand + commands > MAX_DRAW_COMMANDS) {
+      printf("ERROR: Draw command buffer is full\n");
+      exit(EXIT_FAILURE);
+    }
+
+    batch.firstCommand = firstCommand;
+    batch.commandCapacity = commands;
+    firstCommand += batch.commandCapacity;
+
+    batches[i] = {};
+    batches[i].bounds = mesh.bounds;
+    batches[i].firstObject = batch.firstObject;
+    batches[i].objectCount = batch.objectCount;
+    batches[i].meshletCount = meshletCount;
+    batches[i].lodCount = mesh.lods.size();
+    batches[i].firstCommand = batch.firstCommand;
+    batches[i].commandCapacity = batch.commandCapacity;
+    batches[i].firstIndex = mesh.firstIndex;
+    batches[i].vertexOffset = mesh.vertexOffset;
+
+    for (uint32_t level = 0; level < mesh.lods.size(); ++level) {
+      batches[i].lodErrors[level] = mesh.lods[level].error;
+      batches[i].lodFirstMeshlet[level] =
+          mesh.firstMeshlet + mesh.lods[level].firstMeshlet;
+      batches[i].lodMeshletCount[level] = mesh.lods[level].meshletCount;
     }
   }
 }
 
+void Vulkan::recordCulling(VkCommandBuffer commandBuffer) {
+  if (m_drawObjectCount == 0) {
+    return;
+  }
+
+  vkCmdFillBuffer(commandBuffer, m_drawCountBuffer, 0, VK_WHOLE_SIZE, 0);
+  vkCmdFillBuffer(commandBuffer, m_cullStatsBuffer, 0, VK_WHOLE_SIZE, 0);
+
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_cullPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_cullPipelineLayout, 0, 1, &m_cullSet, 0, nullptr);
+
+  for (uint32_t i = 0; i < m_drawBatches.size(); ++i) {
+    if (m_drawBatches[i].commandCapacity == 0) {
+      continue;
+    }
+
+    static_assert(sizeof(i) == cull_comp_reflection.pushConstantSize,
+                  "cull.comp reads another dispatch block");
+    vkCmdPushConstants(commandBuffer, m_cullPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(i), &i);
+    vkCmdDispatch(commandBuffer, (m_drawBatches[i].commandCapacity + 63) / 64,
+                  1, 1);
+  }
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_HOST_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Vulkan::createDepthPyramidPipeline() {
+  if (!m_gpuDriven) {
+    return;
+  }
+
+  // Texels are read as they are, levels past the end clamp to the last one
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  VK_CHECK(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_depthSampler),
+           "Creating depth sampler");
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings =
+      Shaders::setBindings({DEPTH_PYRAMID_COMP}, 0);
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = bindings.size();
+  layoutInfo.pBindings = bindings.data();
+
+  VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr,
+                                       &m_depthPyramidSetLayout),
+           "Creating depth pyramid layout descriptor");
+  m_descriptorCache.addLayout(m_depthPyramidSetLayout, bindings);
+
+  // Source and destination sizes of the level
+  std::vector<VkPushConstantRange> sizeRanges =
+      Shaders::pushConstantRanges({DEPTH_PYRAMID_COMP});
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &m_depthPyramidSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = sizeRanges.size();
+  pipelineLayoutInfo.pPushConstantRanges = sizeRanges.data();
+
+  VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr,
+                                  &m_depthPyramidPipelineLayout),
+           "Creating depth pyramid pipeline layout");
+
+  VkShaderModule reduceModule = nullptr;
+  createShaderModule(DEPTH_PYRAMID_COMP, &reduceModule);
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = reduceModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = m_depthPyramidPipelineLayout;
+
+  VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo,
+                                    nullptr, &m_depthPyramidPipeline),
+           "Creating depth pyramid pipeline");
+
+  vkDestroyShaderModule(m_device, reduceModule, nullptr);
+}
+
+void Vulkan::createDepthPyramid() {
+  if (!m_gpuDriven) {
+    return;
+  }
+
+  // Power of two sizes, every level below the first halves exactly
+  m_depthPyramidWidth = 1;
+  while (m_depthPyramidWidth * 2 <= m_swapchainExtent.width) {
+    m_depthPyramidWidth *= 2;
+  }
+  m_depthPyramidHeight = 1;
+  while (m_depthPyramidHeight * 2 <= m_swapchainExtent.height) {
+    m_depthPyramidHeight *= 2;
+  }
+
+  uint32_t levels =
+      (uint32_t)std::log2(std::max(m_depthPyramidWidth, m_depthPyramidHeight)) +
+      1;
+
+  createImage(m_depthPyramidWidth, m_depthPyramidHeight, levels,
+              VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                  VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthPyramid,
+              m_depthPyramidMemory);
+
+  // The cull set declares GENERAL, culling may bind it before the first build
+  VkImageSubresourceRange range = {};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = VK_REMAINING_MIP_LEVELS;
+  range.layerCount = 1;
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = m_depthPyramid;
+  barrier.subresourceRange = range;
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  // Far plane everywhere, nothing is occluded by it
+  VkClearColorValue farPlane = {{1.0f, 0.0f, 0.0f, 0.0f}};
+  vkCmdClearColorImage(commandBuffer, m_depthPyramid, VK_IMAGE_LAYOUT_GENERAL,
+                       &farPlane, 1, &range);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  endSingleTimeCommands(commandBuffer);
+
+  m_depthPyramidView = createImageView(m_depthPyramid, VK_FORMAT_R32_SFLOAT,
+                                       VK_IMAGE_ASPECT_COLOR_BIT, levels);
+
+  m_depthPyramidLevels.resize(levels);
+  for (uint32_t level = 0; level < levels; ++level) {
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_depthPyramid;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = level;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr,
+                               &m_depthPyramidLevels[level]),
+             "Creating depth pyramid level view");
+  }
+
+  // Each level reduces the one above it, the first reduces the depth buffer
+  m_depthPyramidSets.resize(levels);
+  for (uint32_t level = 0; level < levels; ++level) {
+    std::vector<DescriptorInfo> infos(2);
+    infos[0].image.sampler = m_depthSampler;
+    infos[0].image.imageView =
+        level == 0 ? m_depthImageView : m_depthPyramidLevels[level - 1];
+    infos[0].image.imageLayout = level == 0
+                                     ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                     : VK_IMAGE_LAYOUT_GENERAL;
+    infos[1].image.sampler = VK_NULL_HANDLE;
+    infos[1].image.imageView = m_depthPyramidLevels[level];
+    infos[1].image.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    m_depthPyramidSets[level] =
+        m_descriptorCache.get(m_depthPyramidSetLayout, infos);
+  }
+
+  updateCullSet();
+
+  m_depthPyramidValid = false;
+}
+
+void Vulkan::updateCullSet() {
+  // Storage buffers by binding, then the pyramid
+  VkBuffer cullBuffers[] = {m_objectBuffers[m_objectFront],
+                            m_drawCommandBuffer,
+                            m_drawCountBuffer,
+                            m_cullBuffer,
+                            m_meshletBuffer,
+                            m_cullStatsBuffer};
+  std::vector<DescriptorInfo> cullInfos;
+  for (const VkDescriptorSetLayoutBinding &binding :
+       m_descriptorCache.bindings(m_cullSetLayout)) {
+    DescriptorInfo info = {};
+    if (binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+      info.image.sampler = m_depthSampler;
+      info.image.imageView = m_depthPyramidView;
+      info.image.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    } else {
+      info.buffer.buffer = cullBuffers[binding.binding];
+      info.buffer.offset = 0;
+      info.buffer.range = VK_WHOLE_SIZE;
+    }
+    cullInfos.push_back(info);
+  }
+  m_cullSet = m_descriptorCache.get(m_cullSetLayout, cullInfos);
+}
+
+void Vulkan::destroyDepthPyramid() {
+  if (!m_gpuDriven) {
+    return;
+  }
+
+  for (VkImageView view : m_depthPyramidLevels) {
+    vkDestroyImageView(m_device, view, nullptr);
+  }
+  vkDestroyImageView(m_device, m_depthPyramidView, nullptr);
+  vkDestroyImage(m_device, m_depthPyramid, nullptr);
+  vkFreeMemory(m_device, m_depthPyramidMemory, nullptr);
+}
+
+void Vulkan::recordDepthPyramid(VkCommandBuffer commandBuffer) {
+  // Stale once skipped for a frame, the next culling pass must not use it
+  if (!occlusionCulling) {
+    m_depthPyramidValid = false;
+    return;
+  }
+
+  std::vector<VkImageMemoryBarrier> barriers(2);
+  barriers[0] = {};
+  barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].image = m_depthImage;
+  barriers[0].subresourceRange.aspectMask = m_depthAspect;
+  barriers[0].subresourceRange.levelCount = 1;
+  barriers[0].subresourceRange.layerCount = 1;
+
+  // Rebuilt from scratch, the culling pass of this frame was its last reader
+  barriers[1] = {};
+  barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[1].image = m_depthPyramid;
+  barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barriers[1].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+  barriers[1].subresourceRange.layerCount = 1;
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, barriers.size(), barriers.data());
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_depthPyramidPipeline);
+
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  static_assert(sizeof(uint32_t[4]) ==
+                    depthpyramid_comp_reflection.pushConstantSize,
+                "depthpyramid.comp reads another reduce block");
+  uint32_t sizes[4] = {m_swapchainExtent.width, m_swapchainExtent.height,
+                       m_depthPyramidWidth, m_depthPyramidHeight};
+
+  // The barrier after the last level also covers next frame's culling pass
+  for (uint32_t level = 0; level < m_depthPyramidSets.size(); ++level) {
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_depthPyramidPipelineLayout, 0, 1,
+                            &m_depthPyramidSets[level], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_depthPyramidPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+    vkCmdDispatch(commandBuffer, (sizes[2] + 7) / 8, (sizes[3] + 7) / 8, 1);
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                         0, nullptr, 0, nullptr);
+
+    sizes[0] = sizes[2];
+    sizes[1] = sizes[3];
+    sizes[2] = std::max(sizes[2] / 2, 1u);
+    sizes[3] = std::max(sizes[3] / 2, 1u);
+  }
+
+  // Culling tests next frame's objects with the matrices of this one
+  m_occlusionViewProj = m_ubo.proj * m_ubo.view;
+  m_depthPyramidValid = true;
+}
+
+void Vulkan::destroyMesh(Mesh &mesh) {
+  if (mesh.vertexCount == 0) {
+    return;
+  }
+
+  m_geometryVertices.free(mesh.vertexOffset, mesh.vertexCount);
+  m_geometryIndices.free(mesh.firstIndex, mesh.indexCount);
+
+  mesh = {};
+}
+
+void Vulkan::destroyTexture(Texture &texture) {
+  if (texture.image == VK_NULL_HANDLE) {
+    return;
+  }
+
+  vkDestroyImageView(m_device, texture.view, nullptr);
+  vkDestroyImage(m_device, texture.image, nullptr);
+  vkFreeMemory(m_device, texture.memory, nullptr);
+
+  texture = {};
+}
+
+const Mesh &Vulkan::getMesh(MeshHandle handle) {
+  return m_meshes[handle].resident ? m_meshes[handle] : m_placeholderMesh;
+}
+
+const Texture &Vulkan::getTexture(TextureHandle handle) {
+  return m_textures[handle].resident ? m_textures[handle]
+                                     : m_placeholderTexture;
+}
+
 void Vulkan::keyInputCB(GLFWwindow *window, int key, int scancode, int action,
                         int mods) {
 
@@ -1464,6 +3488,13 @@ void Vulkan::keyInputCB(GLFWwindow *window, int key, int scancode, int action,
   float value = 0.3;
   glm::vec3 inc = {0.0f, 0.0f, 0.0f};
 
+  if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+    app->depthPrepass = !app->depthPrepass;
+  }
+  if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+    app->cullBackFaces = !app->cullBackFaces;
+  }
+
   if (action != GLFW_REPEAT) {
     if (key == GLFW_KEY_W) {
       app->pressed.at(GLFW_KEY_W) = (action == GLFW_PRESS);
@@ -23,6 +23,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #define GLM_HAS_CXX11_STL 1
 #include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <cmath>
 #include <vector>
@@ -32,19 +33,20 @@
 #include <set>
 #include <unordered_map>
 #include <map>
+#include <memory>
 
 #include "utils.h"
 #include "vertices.h"
-
-namespace std {
-  template<> struct hash<Vertex> {
-    size_t operator()(Vertex const& vertex) const {
-      return ((hash<glm::vec3>()(vertex.pos) ^
-               (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-             (hash<glm::vec2>()(vertex.texCoord) << 1);
-    }
-  };
-}
+#include "staging.h"
+#include "streaming.h"
+#include "residency.h"
+#include "culling.h"
+#include "occlusion.h"
+#include "drawlist.h"
+#include "pipelines.h"
+#include "shaders.h"
+#include "geometry.h"
+#include "descriptors.h"
 
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR        capabilities;
@@ -61,12 +63,171 @@ struct QueueFamilyIndices {
   }
 };
 
+// Written once per frame, objects carry their model matrix
 struct UniformBufferObject {
-  alignas( 16 ) glm::mat4 model;
   alignas( 16 ) glm::mat4 view;
   alignas( 16 ) glm::mat4 proj;
 };
 
+// Mirrors the Object struct of triangle.vert and cull.comp ( std430 )
+struct ObjectData {
+  glm::mat4 model;
+  uint32_t  batch;
+  uint32_t  textureIndex;
+  // The material's color, RGBA8, and features for the generic pipelines
+  uint32_t  color;
+  uint32_t  features;
+};
+
+// Mirrors the Draw push constant block of the scene vertex shaders
+struct DrawConstants {
+  // The object is read from here instead of the object buffer when non zero
+  uint32_t   pushed;
+  ObjectData object;
+};
+
+// Mirrors the Batch struct of cull.comp, one per mesh in the scene
+struct BatchData {
+  glm::vec4  bounds;
+  uint32_t   firstObject;
+  uint32_t   objectCount;
+  // Command slots per object, the meshlet count of the largest level
+  uint32_t   meshletCount;
+  uint32_t   lodCount;
+  uint32_t   firstCommand;
+  uint32_t   commandCapacity;
+  // Range of the mesh in the geometry pool, meshlets are relative to it
+  uint32_t   firstIndex;
+  int32_t    vertexOffset;
+  // One lane per level, up to Lod::MAX_LEVELS
+  glm::vec4  lodErrors;
+  glm::uvec4 lodFirstMeshlet;
+  glm::uvec4 lodMeshletCount;
+};
+
+// Header of the cull buffer, the BatchData array follows it
+struct CullData {
+  glm::vec4 planes[ 6 ];
+  glm::vec4 camera;
+  uint32_t  objectCount;
+  uint32_t  compact;
+  float     pixelsPerUnit;
+  float     lodThreshold;
+  glm::mat4 occlusionViewProj;
+  float     pyramidWidth;
+  float     pyramidHeight;
+  uint32_t  occlusion;
+  // The rasterizer culls back faces, meshlets facing away can be dropped
+  uint32_t  backFaces;
+};
+
+// Mirrors the Stats struct of cull.comp, counted by the last culling pass. The
+// CPU path fills the object counts from its software occlusion.
+struct CullingStats {
+  // Objects inside the frustum, and those of them hidden by last frame's depth
+  uint32_t testedObjects;
+  uint32_t occludedObjects;
+  uint32_t occludedMeshlets;
+  uint32_t pad;
+};
+
+typedef uint32_t MaterialHandle;
+
+// Shader features of a material. Bit i is the boolean specialization constant
+// with constant_id i in triangle.vert and the fragment shaders.
+enum MaterialFeature : uint32_t {
+  MATERIAL_VERTEX_COLOR = 1 << 0,
+  MATERIAL_TEXTURE      = 1 << 1,
+};
+
+const uint32_t MATERIAL_FEATURE_COUNT = 2;
+
+// Feature set of the generic pipelines, the next constant_id tells the shaders
+// to read each object's features at runtime. They draw every variant whose
+// pipelines are still compiling.
+const uint32_t GENERIC_FEATURES = 1u << MATERIAL_FEATURE_COUNT;
+
+struct Material {
+  uint32_t  features;
+  // Multiplies the vertex color and the texture when the material has them
+  glm::vec4 color;
+};
+
+// Passes a scene pipeline is made for, every variant has one of each but the
+// depth pre-pass which is shared
+enum ScenePass {
+  SCENE_PASS_COLOR,
+  SCENE_PASS_DEPTH_PREPASS,
+  SCENE_PASS_PREPASS_COLOR,
+};
+
+struct SceneObject {
+  MeshHandle     mesh;
+  TextureHandle  texture;
+  MaterialHandle material;
+  glm::mat4      transform;
+};
+
+// Objects sharing a mesh and shader variant, drawn with one indirect call.
+// Each meshlet of each object gets a command slot in
+// [ firstCommand, firstCommand + commandCapacity )
+struct DrawBatch {
+  MeshHandle mesh;
+  uint32_t   firstObject;
+  uint32_t   objectCount;
+  uint32_t   firstCommand;
+  uint32_t   commandCapacity;
+  // Slot of the variant's pipelines
+  uint32_t   pipeline;
+};
+
+// A draw of the CPU culling path, its instances are a run of the instance
+// buffer
+struct CpuDraw {
+  uint32_t batch;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // Object of the first instance, its distance orders the draw list
+  uint32_t object;
+  // Single object draws push it, the instance buffer doesn't hold it
+  bool     pushed;
+};
+
+struct Mesh {
+  // Ranges of the geometry pool, draws add them to the mesh's own offsets
+  uint32_t       vertexOffset;
+  uint32_t       vertexCount;
+  uint32_t       firstIndex;
+  uint32_t       indexCount;
+  // Bounding sphere in model space, xyz center and w radius
+  glm::vec4      bounds;
+  // CPU copy for culling on the CPU, firstMeshlet indexes the GPU table
+  std::vector< Meshlet > meshlets;
+  uint32_t       firstMeshlet;
+  std::vector< MeshLod > lods;
+  // Coarsest level compacted to its own vertices, drawn by the CPU occlusion
+  std::vector< glm::vec3 > occluderPositions;
+  std::vector< uint32_t >  occluderIndices;
+  bool           resident;
+};
+
+struct Texture {
+  VkImage        image;
+  VkDeviceMemory memory;
+  VkImageView    view;
+  uint32_t       width;
+  uint32_t       height;
+  // The image only holds levels baseMipLevel to fullMipLevels - 1 of the chain
+  uint32_t       baseMipLevel;
+  uint32_t       mipLevels;
+  uint32_t       fullMipLevels;
+  VkDeviceSize   size;
+  bool           resident;
+  bool           streaming;
+};
+
 class Vulkan {
 public:
   void run( uint32_t width, uint32_t height, char* name );
@@ -76,7 +237,39 @@ public:
   glm::vec3 look_at = glm::vec3(0.0f, 0.0f, 0.0f);
   glm::vec3 up      = glm::vec3(0.0f, -1.0f, 0.0f);
   std::map< uint32_t, bool > pressed;
+
+  // Bytes of texture memory kept resident before least recently used ones are shrunk
+  VkDeviceSize textureBudget = 512 * 1024 * 1024;
+  // Uses one descriptor indexed texture array when the device supports it
+  bool bindlessTextures = true;
+  // Culls on the GPU and draws each mesh with one indirect call when supported
+  bool gpuDrivenRendering = true;
+  // The model is instanced on a sceneGridSize x sceneGridSize grid
+  uint32_t sceneGridSize = 1;
+  // Coarser levels are picked while their error stays under this many pixels
+  float lodThreshold = 1.0f;
+  // Without GPU culling, objects sharing a mesh and LOD level are drawn as
+  // instances of one draw. Otherwise each object draws its visible meshlets.
+  bool instancing = true;
+  // GPU culling also rejects what last frame's depth buffer hides
+  bool occlusionCulling = true;
+  // Without GPU culling, the biggest objects on screen are rasterized on the
+  // CPU and the objects they hide are skipped
+  bool softwareOcclusion = true;
+  // Draws the scene once into depth only, then shades with an equal depth test
+  // so every pixel runs the fragment shader once. Toggled with P.
+  bool depthPrepass = false;
+  // Vertex shaders fetch the geometry pool from storage buffers with the
+  // vertex index, pipelines don't depend on the vertex format
+  bool vertexPulling = true;
+  // Begins the attachments directly on Vulkan 1.3 or VK_KHR_dynamic_rendering,
+  // no render pass or framebuffer objects. The cull mode is then dynamic too.
+  bool dynamicRendering = true;
+  // Toggled with C, only where the cull mode is dynamic state
+  bool cullBackFaces = true;
   void smoothCameraMovement( glm::vec3 inc );
+  CullingStats cullingStats() const { return m_cullingStats; }
+  BindCounts bindCounts() const { return m_bindCounts; }
 
 private:
   void initVulkan();
@@ -91,29 +284,78 @@ private:
   void createImageView();
   void createRenderPass();
   void createGraphicsPipeline();
+  void destroyGraphicsPipeline();
+  VkPipeline createScenePipeline( uint32_t features, ScenePass pass, VkPipelineCache cache );
+  std::shared_future< VkPipeline > compileScenePipeline( uint32_t features, ScenePass pass );
+  void createVariantPipelines( uint32_t features );
+  void updatePipelines();
+  uint32_t variantSlot( uint32_t features );
+  MaterialHandle createMaterial( const Material& material );
   void createFrameBuffers();
   void createCommandPool();
-  void createVertexBuffer();
+  void createUploadScheduler();
   void createCommandBuffers();
-  void createDescriptorPool();
-  void createDescriptorSets();
+  void createDescriptorAllocators();
+  VkDescriptorSet allocateSceneSet();
   void createSyncObjects();
-  void createIndexBuffer();
   void createDescriptorSetLayout();
-  void updateUniformBuffer( uint32_t currentImage );
+  const char* sceneVertexShader( bool depthOnly );
+  std::vector< VkDescriptorSetLayoutBinding > sceneBindings( uint32_t set );
+  void createBindlessDescriptors();
+  bool queryBindlessSupport();
+  bool queryDynamicRenderingSupport();
+  void createSceneBuffers();
+  void createGeometryPool();
+  void createCullingPipeline();
+  void updateCullSet();
+  void addObject( MeshHandle mesh, TextureHandle texture, MaterialHandle material, const glm::mat4& transform );
+  void updateScene();
+  void updateCulling();
+  void updateVisibility();
+  void updateSoftwareOcclusion( const glm::vec3& camera );
+  void recordCulling( VkCommandBuffer commandBuffer );
+  void createDepthPyramidPipeline();
+  void createDepthPyramid();
+  void destroyDepthPyramid();
+  void recordDepthPyramid( VkCommandBuffer commandBuffer );
+  void updateUniformBuffer();
   void createUniformBuffers();
-  void createTextureImage();
-  void createTextureImageView();
   void createTextureSampler();
   void createDepthResources();
-  void loadModel();
+  void createPlaceholders();
+  void recordCommandBuffer( uint32_t imageIndex );
+  void beginScenePass( VkCommandBuffer commandBuffer, uint32_t imageIndex );
+  void endScenePass( VkCommandBuffer commandBuffer, uint32_t imageIndex );
+  void buildDrawList();
+  void recordDraws( VkCommandBuffer commandBuffer, const VkPipeline* pipelines, BoundState& bound );
+  MeshHandle requestMesh( const char* path );
+  TextureHandle requestTexture( const char* path );
+  void updateStreaming();
+  void createMesh( const MeshData& data, Mesh& mesh, uint32_t priority, std::function< void() > completed );
+  void createTexture( const TextureData& data, uint32_t baseMipLevel, Texture& texture, uint32_t priority, std::function< void() > completed );
+  void allocateTexture( const TextureData& data, uint32_t baseMipLevel, Texture& texture );
+  void destroyMesh( Mesh& mesh );
+  void destroyTexture( Texture& texture );
+  const Mesh& getMesh( MeshHandle handle );
+  const Texture& getTexture( TextureHandle handle );
+  void updateTextureDescriptors();
+  void updateBindlessDescriptors();
+  void markTextureDirty( TextureHandle handle );
+  void createTextureResidency();
+  void updateTextureUsage();
+  void useTexture( TextureHandle handle, uint32_t desiredMipLevel );
+  void updateResidency();
+  void streamTexture( TextureHandle handle );
+  void resizeTexture( TextureHandle handle, uint32_t baseMipLevel );
+  void swapTexture( TextureHandle handle, const Texture& incoming );
+  uint32_t tailMipLevel( const TextureData& data );
+  uint32_t desiredMipLevel( const Mesh& mesh, const glm::mat4& transform, const Texture& texture );
   void createBuffer( VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory );
-  void copyBuffer( VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size );
   void invalidateSwapchain();
   void updateSwapchain();
   static void frameResizedCB( GLFWwindow* window, int width, int height );
   static void keyInputCB( GLFWwindow* window, int key, int scancode, int action, int mods );
-  void createShaderModule( std::vector< char > code, VkShaderModule* shaderModule );
+  void createShaderModule( const char* name, VkShaderModule* shaderModule );
   std::vector<const char*> getExtensions();
   QueueFamilyIndices getGraphicQueue();
   SwapChainSupportDetails getSwapchainSupport();
@@ -121,12 +363,11 @@ private:
   VkPresentModeKHR chooseSwapPresentMode( const std::vector<VkPresentModeKHR>& availablePresentModes );
   VkExtent2D chooseSwapExtent( const VkSurfaceCapabilitiesKHR& capabilities );
   uint32_t findMemoryType( uint32_t typeFilter, VkMemoryPropertyFlags properties );
-  void createImage( uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory );
+  void createImage( uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory );
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands( VkCommandBuffer commandBuffer );
   void transitionImageLayout( VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout );
-  void copyBufferToImage( VkBuffer buffer, VkImage image, uint32_t width, uint32_t height );
-  VkImageView createImageView( VkImage image, VkFormat format, VkImageAspectFlags aspectFlags );
+  VkImageView createImageView( VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels );
   VkFormat findSupportedFormat( const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features );
   VkFormat findDepthFormat();
   bool hasStencilComponent( VkFormat format );
@@ -145,42 +386,203 @@ private:
   std::vector<VkImageView> m_swapchainImageViews;
   VkFormat m_swapchainImageFormat;
   VkExtent2D m_swapchainExtent;
-  VkRenderPass m_renderPass;
+  // Both stay null with dynamic rendering
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
   std::vector<VkFramebuffer> m_swapchainFramebuffers;
+  // Color format the scene pipelines were built for, they only depend on it
+  VkFormat m_sceneColorFormat;
   VkPipelineLayout m_pipelineLayout;
   VkCommandPool m_commandPool;
   std::vector<VkCommandBuffer> m_commandBuffers;
-  VkPipeline m_pipeline;
+  // Position only pipeline of the pre-pass, shared by every variant
+  VkPipeline m_depthPrepassPipeline;
+  VkPipeline m_genericColorPipeline;
+  VkPipeline m_genericPrepassColorPipeline;
+  VkShaderModule m_sceneVertShader;
+  VkShaderModule m_sceneFragShader;
+  VkShaderModule m_depthVertShader;
+
+  // Pipelines of every shader variant in use, queued when a material first
+  // needs them. The slots are the draw list's pipeline field, one table per
+  // pass so each pass looks its pipelines up by slot. Slots hold the generic
+  // pipelines until theirs are compiled.
+  struct PendingPipeline {
+    uint32_t                       slot;
+    ScenePass                      pass;
+    std::shared_future<VkPipeline> pipeline;
+  };
+
+  PipelineCompiler m_pipelineCompiler;
+  std::unordered_map<uint32_t, uint32_t> m_variantSlots;
+  std::vector<uint32_t>        m_variantFeatures;
+  std::vector<VkPipeline>      m_colorPipelines;
+  std::vector<VkPipeline>      m_prepassColorPipelines;
+  std::vector<VkPipeline>      m_depthPipelines;
+  std::vector<PendingPipeline> m_pendingPipelines;
+
+  // Materials and the variant slot each one draws with
+  std::vector<Material> m_materials;
+  std::vector<uint32_t> m_materialSlots;
+
   std::vector<VkSemaphore> m_imageAvailableSemaphores;
   std::vector<VkSemaphore> m_renderFinishedSemaphores;
   std::vector<VkFence> m_inFlightFences;
   VkQueue m_presentQueue;
   VkQueue m_graphicsQueue;
-  VkBuffer m_vertexBuffer;
-  VkDeviceMemory m_vertexMemory;
-  VkBuffer m_indexBuffer;
-  VkDeviceMemory m_indexMemory;
   VkDescriptorSetLayout m_descriptorSetLayout;
+  // One per frame in flight, persistently mapped
   std::vector<VkBuffer> m_uniformBuffers;
   std::vector<VkDeviceMemory> m_uniformMemory;
-  VkDescriptorPool m_descriptorPool;
-  std::vector<VkDescriptorSet> m_descriptorSets;
-  VkImage m_textureImage;
-  VkDeviceMemory m_textureImageMemory;
-  VkImageView m_textureImageView;
+  std::vector<void*> m_uniformMapped;
+  // Written for every frame from the frame's pools
+  VkDescriptorSet m_sceneSet;
+  std::vector<DescriptorAllocator> m_frameDescriptors;
+  DescriptorAllocator m_cachedDescriptors;
+  DescriptorCache m_descriptorCache;
   VkSampler m_textureSampler;
+  VkDescriptorSetLayout m_bindlessSetLayout;
+  VkDescriptorPool m_bindlessPool;
+  VkDescriptorSet m_bindlessSet;
+  // The scene is uploaded to the object buffer not drawn from, which is
+  // swapped in with the batches once the upload completes
+  VkBuffer m_objectBuffers[2];
+  VkDeviceMemory m_objectMemory[2];
+  uint32_t m_objectFront = 0;
+  bool m_objectUploadPending = false;
+  VkBuffer m_drawCommandBuffer;
+  VkDeviceMemory m_drawCommandMemory;
+  VkBuffer m_drawCountBuffer;
+  VkDeviceMemory m_drawCountMemory;
+  // Every mesh's vertices and indices, the position stream fills the start of
+  // the vertex buffer and the attribute stream follows it
+  VkBuffer m_geometryVertexBuffer;
+  VkDeviceMemory m_geometryVertexMemory;
+  VkDeviceSize m_geometryAttributeOffset;
+  VkBuffer m_geometryIndexBuffer;
+  VkDeviceMemory m_geometryIndexMemory;
+  RangeAllocator m_geometryVertices;
+  RangeAllocator m_geometryIndices;
+  VkBuffer m_meshletBuffer;
+  VkDeviceMemory m_meshletMemory;
+  uint32_t m_meshletCount = 0;
+  VkBuffer m_cullBuffer;
+  VkDeviceMemory m_cullMemory;
+  void* m_cullMapped;
+  VkDescriptorSetLayout m_cullSetLayout;
+  VkDescriptorSet m_cullSet;
+  VkPipelineLayout m_cullPipelineLayout;
+  VkPipeline m_cullPipeline;
+  PFN_vkCmdDrawIndexedIndirectCountKHR m_drawIndexedIndirectCount = nullptr;
+  PFN_vkCmdBeginRenderingKHR m_cmdBeginRendering = nullptr;
+  PFN_vkCmdEndRenderingKHR m_cmdEndRendering = nullptr;
+  PFN_vkCmdSetCullModeEXT m_cmdSetCullMode = nullptr;
   VkImage m_depthImage;
   VkDeviceMemory m_depthImageMemory;
   VkImageView m_depthImageView;
+  VkBuffer m_cullStatsBuffer;
+  VkDeviceMemory m_cullStatsMemory;
+  void* m_cullStatsMapped;
+  CullingStats m_cullingStats = {};
+
+  // Max reduced mip chain of the depth buffer, rebuilt after every frame
+  VkSampler m_depthSampler;
+  VkDescriptorSetLayout m_depthPyramidSetLayout;
+  VkPipelineLayout m_depthPyramidPipelineLayout;
+  VkPipeline m_depthPyramidPipeline;
+  VkImage m_depthPyramid;
+  VkDeviceMemory m_depthPyramidMemory;
+  VkImageView m_depthPyramidView;
+  std::vector<VkImageView> m_depthPyramidLevels;
+  std::vector<VkDescriptorSet> m_depthPyramidSets;
+  VkImageAspectFlags m_depthAspect;
+  uint32_t m_depthPyramidWidth;
+  uint32_t m_depthPyramidHeight;
+  // Cleared when the pyramid is recreated, set once it holds a frame
+  bool m_depthPyramidValid = false;
+  glm::mat4 m_occlusionViewProj;
+
+  UploadScheduler  m_uploads;
+  AssetStreamer    m_streamer;
+  TextureResidency m_residency;
+
+  // Handles index these tables, unloaded entries draw the placeholders
+  std::vector<Mesh>    m_meshes;
+  std::vector<Texture> m_textures;
+  std::vector<std::shared_ptr<TextureData>> m_textureSources;
+  Mesh                 m_placeholderMesh;
+  Texture              m_placeholderTexture;
+  MeshHandle           m_model;
+  TextureHandle        m_modelTexture;
+  bool                 m_texturesDirty = false;
+  std::vector<TextureHandle> m_dirtyTextures;
+
+  // Scene objects in insertion order, the GPU copy is sorted by mesh
+  std::vector<SceneObject> m_objects;
+  std::vector<DrawBatch>   m_drawBatches;
+  std::vector<ObjectData>  m_drawObjects;
+  uint32_t                 m_drawObjectCount = 0;
+  bool                     m_sceneDirty      = false;
+
+  // CPU culling, used when the GPU driven path is not available
+  Bvh                   m_bvh;
+  bool                  m_bvhDirty = false;
+  std::vector<uint32_t> m_visibleObjects;
+  SoftwareOcclusion     m_occlusion;
+  std::vector<CpuDraw>  m_cpuDraws;
+  std::vector<uint64_t> m_instanceKeys;
+
+  // Every draw of the frame sorted by state, recorded by both passes
+  DrawList              m_drawList;
+  BindCounts            m_bindCounts = {};
+  // Visible objects in draw order, rewritten every frame
+  VkBuffer              m_instanceBuffer;
+  VkDeviceMemory        m_instanceMemory;
+  void*                 m_instanceMapped;
+
+  const VkDeviceSize STAGING_RING_SIZE   = 32 * 1024 * 1024;
+  const VkDeviceSize UPLOAD_FRAME_BUDGET = 4 * 1024 * 1024;
+  // Largest mip level uploaded before a texture is first drawn
+  const uint32_t     STREAMING_TAIL_SIZE = 64;
+
+  // Version the instance was created with, capped to 1.3
+  uint32_t m_apiVersion     = VK_API_VERSION_1_0;
+  bool m_hasProperties2     = false;
+  bool m_hasMemoryBudget    = false;
+  bool m_hasUpdateTemplates = false;
+  bool m_bindless           = false;
+
+  bool m_gpuDriven            = false;
+  bool m_vertexPulling        = false;
+  bool m_hasDrawIndirectCount = false;
+  bool m_dynamicRendering     = false;
+  // Core 1.3 entry points, the KHR and EXT ones otherwise
+  bool m_dynamicRenderingCore = false;
+
+  const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+  const uint32_t MAX_OBJECTS           = 65536;
+  const uint32_t MAX_DRAW_BATCHES      = 1024;
+  const uint32_t MAX_MESHLETS          = 256 * 1024;
+  const uint32_t MAX_DRAW_COMMANDS     = 1024 * 1024;
+  const uint32_t MAX_GEOMETRY_VERTICES = 2 * 1024 * 1024;
+  const uint32_t MAX_GEOMETRY_INDICES  = 16 * 1024 * 1024;
+  // Sets of the first pool of a chain, later ones double
+  const uint32_t FRAME_DESCRIPTOR_SETS  = 4;
+  const uint32_t CACHED_DESCRIPTOR_SETS = 16;
+  const float    SCENE_GRID_SPACING    = 2.5f;
+  // Occluders are the biggest objects whose radius over distance passes this
+  const uint32_t MAX_OCCLUDERS         = 32;
+  const float    MIN_OCCLUDER_SIZE     = 0.05f;
+  uint32_t       m_bindlessCapacity    = 0;
 
   const int MAX_FRAMES_IN_FLIGHT = 2;
   size_t    m_currentFrame       = 0;
+  uint64_t  m_frameCount         = 0;
 
   glm::vec3 m_smoothCamera = { 0, 0, 0 };
+  UniformBufferObject m_ubo;
 
-  Shader m_triangle;
   Shader m_rectangle;
-  std::vector<uint32_t> m_rectIndices;// = { 0, 1, 2, 2, 3, 0, 4, 5, 6, 6, 7, 4 };
+  std::vector<uint32_t> m_rectIndices = { 0, 1, 2, 2, 3, 0, 4, 5, 6, 6, 7, 4 };
 };
 
 #endif